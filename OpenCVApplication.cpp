@@ -11,6 +11,12 @@
 #include "morphological_operations.h"
 #include "noise.h"
 #include "statistical_properties.h"
+#include "batch_analysis.h"
+#include "chain_code_io.h"
+#include "polygon_approximation.h"
+#include "contour_matching.h"
+#include "fourier_descriptors.h"
+#include "subpixel_contours.h"
 
 wchar_t* projectPath;
 
@@ -779,11 +785,16 @@ void floyd_steinberg(char* file_name) {
 
 
 
-int main() 
+int main(int argc, char** argv) 
 {
 	cv::utils::logging::setLogLevel(cv::utils::logging::LOG_LEVEL_FATAL);
     projectPath = _wgetcwd(0, 0);
 
+	// Headless mode: OpenCVApplication --batch <folder> <extension> <output prefix>
+	if (argc == 5 && strcmp(argv[1], "--batch") == 0) {
+		return runBatchObjectAnalysis(argv[2], argv[3], argv[4]) >= 0 ? 0 : 1;
+	}
+
 	int op;
 	do
 	{
@@ -834,6 +845,17 @@ int main()
 		printf(" 42 - Automatic global binarization\n");
 		printf(" 43 - Histogram transformations\n");
 		printf(" 44 - Equalization\n");
+		printf(" 45 - Streaming labeling (row by row)\n");
+		printf(" 46 - Flat zone / tolerance labeling\n");
+		printf(" 47 - 3D labeling of a slice stack\n");
+		printf(" 48 - Batch object analysis of a folder\n");
+		printf(" 49 - All borders and holes (Suzuki-Abe)\n");
+		printf(" 50 - Chain code archive (packed, memory mapped)\n");
+		printf(" 51 - Contours of all labeled objects (parallel)\n");
+		printf(" 52 - Polygon approximation of contours\n");
+		printf(" 53 - Contour matching against a library\n");
+		printf(" 54 - Fourier descriptors of contours\n");
+		printf(" 55 - Sub-pixel contours (marching squares)\n");
 		printf(" 0 - Exit\n\n");
 		printf("Option: ");
 		scanf("%d",&op);
@@ -971,6 +993,39 @@ int main()
 			case 44:
 				histogramEqualization();
 				break;
+			case 45:
+				testStreamingLabeling();
+				break;
+			case 46:
+				testFlatZoneLabeling();
+				break;
+			case 47:
+				testVolumeLabeling();
+				break;
+			case 48:
+				testBatchObjectAnalysis();
+				break;
+			case 49:
+				testAllBorders();
+				break;
+			case 50:
+				testChainCodeArchive();
+				break;
+			case 51:
+				testLabeledContours();
+				break;
+			case 52:
+				testPolygonApproximation();
+				break;
+			case 53:
+				testContourMatching();
+				break;
+			case 54:
+				testFourierDescriptors();
+				break;
+			case 55:
+				testSubpixelContours();
+				break;
 
 		}
 	}
@@ -0,0 +1,221 @@
+#include "stdafx.h"
+#include "batch_analysis.h"
+#include "common.h"
+
+// Columnar file layout (little endian):
+//   "OBJT", version, column count, then per column: name length, name, type ('i' int32 / 'f' float32)
+//   row groups: row count, then the values of each column stored contiguously
+//   a row group with 0 rows ends the file
+static const int BATCH_FORMAT_VERSION = 1;
+static const int FILES_PER_GROUP = 256;
+
+struct BatchColumn {
+    const char* name;
+    char type;
+};
+
+static const BatchColumn batchColumns[] = {
+    { "file", 'i' },
+    { "label", 'i' },
+    { "area", 'i' },
+    { "center_x", 'f' },
+    { "center_y", 'f' },
+    { "orientation", 'f' },
+    { "elongation", 'f' },
+    { "thinness", 'f' },
+    { "perimeter", 'i' },
+    { "bbox_x", 'i' },
+    { "bbox_y", 'i' },
+    { "bbox_width", 'i' },
+    { "bbox_height", 'i' },
+    { "hu1", 'f' }, { "hu2", 'f' }, { "hu3", 'f' }, { "hu4", 'f' },
+    { "hu5", 'f' }, { "hu6", 'f' }, { "hu7", 'f' },
+    { "zernike_00", 'f' }, { "zernike_11", 'f' }, { "zernike_20", 'f' },
+    { "zernike_22", 'f' }, { "zernike_31", 'f' }, { "zernike_33", 'f' },
+    { "zernike_40", 'f' }, { "zernike_42", 'f' }, { "zernike_44", 'f' },
+    { "min_rect_cx", 'f' }, { "min_rect_cy", 'f' }, { "min_rect_width", 'f' },
+    { "min_rect_height", 'f' }, { "min_rect_angle", 'f' },
+    { "convex_area", 'f' }, { "solidity", 'f' }, { "feret_max", 'f' }, { "feret_min", 'f' },
+};
+static const int BATCH_COLUMN_COUNT = sizeof(batchColumns) / sizeof(batchColumns[0]);
+
+// Values of one row group, column by column; floats are kept by bit pattern
+struct ColumnGroup {
+    vector<int> columns[BATCH_COLUMN_COUNT];
+    int rows = 0;
+
+    void addRow(int file, const ObjectProps& p) {
+        float floats[5 + 7 + ZERNIKE_COUNT + 9] = { p.center.x, p.center.y, p.orientation, p.elongation, p.thinnessFactor };
+        for (int h = 0; h < 7; h++) {
+            floats[5 + h] = (float)p.hu[h];
+        }
+        copy(p.zernike, p.zernike + ZERNIKE_COUNT, floats + 5 + 7);
+        float hull[] = { p.minAreaRect.center.x, p.minAreaRect.center.y, p.minAreaRect.size.width,
+            p.minAreaRect.size.height, p.minAreaRect.angle, p.convexArea, p.solidity, p.maxFeret, p.minFeret };
+        copy(hull, hull + 9, floats + 5 + 7 + ZERNIKE_COUNT);
+        int ints[] = { file, p.label, p.area, p.perimeter,
+            p.boundingBox.x, p.boundingBox.y, p.boundingBox.width, p.boundingBox.height };
+        int f = 0, k = 0;
+        for (int c = 0; c < BATCH_COLUMN_COUNT; c++) {
+            int value;
+            if (batchColumns[c].type == 'f') {
+                memcpy(&value, &floats[f++], sizeof(value));
+            }
+            else {
+                value = ints[k++];
+            }
+            columns[c].push_back(value);
+        }
+        rows++;
+    }
+};
+
+Mat readLabelMap(const char* fileName) {
+    Mat image = imread(fileName, IMREAD_UNCHANGED);
+    if (image.empty()) {
+        return image;
+    }
+    if (image.channels() > 1) {
+        Mat gray;
+        cvtColor(image, gray, image.channels() == 4 ? COLOR_BGRA2GRAY : COLOR_BGR2GRAY);
+        image = gray;
+    }
+    if (image.depth() != CV_8U && image.depth() != CV_32S) {
+        Mat labels;
+        image.convertTo(labels, CV_32S);
+        image = labels;
+    }
+    return image;
+}
+
+static void writeColumnHeader(BufferedWriter& binary, BufferedWriter& csv) {
+    binary.write("OBJT", 4);
+    binary.write(&BATCH_FORMAT_VERSION, sizeof(int));
+    binary.write(&BATCH_COLUMN_COUNT, sizeof(int));
+    for (int c = 0; c < BATCH_COLUMN_COUNT; c++) {
+        int length = (int)strlen(batchColumns[c].name);
+        binary.write(&length, sizeof(int));
+        binary.write(batchColumns[c].name, length);
+        binary.write(&batchColumns[c].type, 1);
+        csv.print(c == 0 ? "%s" : ",%s", batchColumns[c].name);
+    }
+    csv.print("\n");
+}
+
+static void writeRowGroup(const ColumnGroup& group, BufferedWriter& binary, BufferedWriter& csv) {
+    binary.write(&group.rows, sizeof(int));
+    for (int c = 0; c < BATCH_COLUMN_COUNT; c++) {
+        if (group.rows > 0) {
+            binary.write(group.columns[c].data(), group.rows * sizeof(int));
+        }
+    }
+
+    for (int r = 0; r < group.rows; r++) {
+        for (int c = 0; c < BATCH_COLUMN_COUNT; c++) {
+            int value = group.columns[c][r];
+            const char* separator = c == 0 ? "" : ",";
+            if (batchColumns[c].type == 'f') {
+                float f;
+                memcpy(&f, &value, sizeof(f));
+                csv.print("%s%.6g", separator, f);
+            }
+            else {
+                csv.print("%s%d", separator, value);
+            }
+        }
+        csv.print("\n");
+    }
+}
+
+int runBatchObjectAnalysis(const char* folder, const char* extension, const char* outputPrefix) {
+    // FileGetter builds "<folder>\*.<ext>" in a MAX_PATH buffer
+    if (strlen(folder) + strlen(extension) + 3 >= MAX_PATH) {
+        printf("Folder or extension too long\n");
+        return -1;
+    }
+
+    string prefix = outputPrefix;
+    BufferedWriter csv((prefix + ".csv").c_str());
+    BufferedWriter binary((prefix + ".objt").c_str());
+    BufferedWriter names((prefix + "_files.txt").c_str(), 1 << 16);
+    if (!csv.isOpen() || !binary.isOpen() || !names.isOpen()) {
+        printf("Could not create the output files %s.*\n", outputPrefix);
+        return -1;
+    }
+    writeColumnHeader(binary, csv);
+
+    char folderName[MAX_PATH];
+    char ext[MAX_PATH];
+    strcpy(folderName, folder);
+    strcpy(ext, extension);
+    FileGetter fg(folderName, ext);
+
+    char fname[MAX_PATH];
+    int fileCount = 0;
+    bool more = true;
+    while (more) {
+        // Collect a group of files, analyze them in parallel, then write them in file order
+        vector<string> files;
+        while ((int)files.size() < FILES_PER_GROUP && (more = fg.getNextAbsFile(fname) != 0)) {
+            files.push_back(fname);
+        }
+        if (files.empty()) {
+            break;
+        }
+
+        vector<vector<ObjectProps>> results(files.size());
+        parallel_for_(Range(0, (int)files.size()), [&](const Range& range) {
+            for (int f = range.start; f < range.end; f++) {
+                Mat labels = readLabelMap(files[f].c_str());
+                if (!labels.empty()) {
+                    results[f] = computeAllObjectProperties(labels);
+                }
+            }
+            });
+
+        ColumnGroup group;
+        for (size_t f = 0; f < files.size(); f++) {
+            names.print("%s\n", files[f].c_str());
+            for (const ObjectProps& props : results[f]) {
+                if (props.area > 0) {
+                    group.addRow(fileCount + (int)f, props);
+                }
+            }
+        }
+        writeRowGroup(group, binary, csv);
+        fileCount += (int)files.size();
+    }
+
+    ColumnGroup end;
+    writeRowGroup(end, binary, csv);
+    bool written = csv.close();
+    written = binary.close() && written;
+    written = names.close() && written;
+    if (!written) {
+        printf("Could not write the output files %s.*\n", outputPrefix);
+        return -1;
+    }
+    return fileCount;
+}
+
+void testBatchObjectAnalysis() {
+    char folderName[MAX_PATH];
+    if (openFolderDlg(folderName) == 0) {
+        return;
+    }
+
+    char extension[MAX_PATH];
+    char outputPrefix[MAX_PATH];
+    printf("Enter label image extension (e.g. bmp): ");
+    scanf("%s", extension);
+    printf("Enter output path prefix: ");
+    scanf("%s", outputPrefix);
+
+    double t = (double)getTickCount();
+    int files = runBatchObjectAnalysis(folderName, extension, outputPrefix);
+    t = ((double)getTickCount() - t) / getTickFrequency();
+    if (files >= 0) {
+        printf("Analyzed %d files, time = %.3f [ms]\n", files, t * 1000);
+    }
+    system("pause");
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+#include <string>
+#include <vector>
+#include "image.h"
+
+using namespace cv;
+using namespace std;
+
+// Non-interactive object analysis of every labeled image <folder>\*.<extension>. Files are
+// analyzed in parallel; results go to <outputPrefix>.csv, to the columnar binary file
+// <outputPrefix>.objt and to the file name list <outputPrefix>_files.txt.
+// Returns the number of analyzed files, or -1 when an output file cannot be created.
+int runBatchObjectAnalysis(const char* folder, const char* extension, const char* outputPrefix);
+
+// Reads a labeled image as a CV_8UC1 or CV_32SC1 label map
+Mat readLabelMap(const char* fileName);
+
+void testBatchObjectAnalysis();
@@ -1,8 +1,12 @@
 #include "stdafx.h"
 #include "border_detection.h"
 #include "common.h"
+#include "chain_code_analysis.h"
 #include <fstream>
 
+static const int EAST_INDEX = 0;
+static const int WEST_INDEX = 4;
+
 Point getNextPoint(const Point& current, Direction dir) {
     const int dx[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
     const int dy[8] = { 0, -1, -1, -1, 0, 1, 1, 1 };
@@ -139,45 +143,429 @@ ChainCode getChainedCode() {
         return chainCode;
     }
 
-    chainCode.start = startPoint;
-    chainCode.directions.clear();
-
-    Point P0 = startPoint;
-    Direction dir = EAST;
+    return FastBorderTracer(binaryImg).trace(startPoint);
+}
 
-    vector<Point> contourPoints;
-    contourPoints.push_back(P0);
+ChainCode traceBorder(const Mat_<uchar>& image, Point start) {
+    ChainCode chainCode;
+    chainCode.start = start;
 
-    Point currentPoint = P0;
+    Point P0 = start;
     Point P1;
+    Point currentPoint = P0;
+    Direction dir = EAST;
     bool firstStep = true;
 
-    do {
-        dir = getNextDirection(binaryImg, currentPoint, dir);
-
-        chainCode.directions.push_back(dir);
+    while (true) {
+        dir = getNextDirection(image, currentPoint, dir);
+        Point nextPoint = getNextPoint(currentPoint, dir);
 
-        currentPoint = getNextPoint(currentPoint, dir);
+        // A single pixel object has no neighbor to move to
+        if (nextPoint.x < 0 || nextPoint.x >= image.cols || nextPoint.y < 0 || nextPoint.y >= image.rows ||
+            image(nextPoint.y, nextPoint.x) != 0) {
+            break;
+        }
 
         if (firstStep) {
-            P1 = currentPoint;
+            P1 = nextPoint;
             firstStep = false;
         }
+        else if (currentPoint == P0 && nextPoint == P1) {
+            break;
+        }
 
-        contourPoints.push_back(currentPoint);
+        chainCode.directions.push_back(dir);
+        currentPoint = nextPoint;
+    }
 
-        if (contourPoints.size() > 2 && currentPoint == P1 && contourPoints[contourPoints.size() - 2] == P0) {
+    chainCode.length = chainCode.directions.size();
+
+    return chainCode;
+}
+
+vector<TracedBorder> traceAllBorders(const Mat_<uchar>& image) {
+    const int dx[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+    const int dy[8] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+
+    // Working copy with a background frame: 1 = object, 0 = background, +-NBD = border numbers
+    Mat_<int> f = Mat_<int>::zeros(image.rows + 2, image.cols + 2);
+    for (int y = 0; y < image.rows; y++) {
+        for (int x = 0; x < image.cols; x++) {
+            f(y + 1, x + 1) = image(y, x) == 0 ? 1 : 0;
+        }
+    }
+
+    // Border NBD is stored at index NBD - 2; NBD 1 is the frame
+    vector<TracedBorder> borders;
+    int nbd = 1;
+
+    for (int i = 1; i <= image.rows; i++) {
+        int lnbd = 1;
+        for (int j = 1; j <= image.cols; j++) {
+            int fij = f(i, j);
+            int fromDir;
+            bool isHole;
+            if (fij == 1 && f(i, j - 1) == 0) {
+                isHole = false;
+                fromDir = WEST_INDEX;
+            }
+            else if (fij >= 1 && f(i, j + 1) == 0) {
+                isHole = true;
+                fromDir = EAST_INDEX;
+                if (fij > 1) {
+                    lnbd = fij;
+                }
+            }
+            else {
+                if (fij != 0 && fij != 1) {
+                    lnbd = abs(fij);
+                }
+                continue;
+            }
+
+            nbd++;
+            TracedBorder border;
+            border.isHole = isHole;
+            border.chainCode.start = Point(j - 1, i - 1);
+            int parent = lnbd == 1 ? -1 : lnbd - 2;
+            bool parentIsHole = lnbd == 1 ? true : borders[parent].isHole;
+            if (isHole == parentIsHole) {
+                border.parent = parent == -1 ? -1 : borders[parent].parent;
+            }
+            else {
+                border.parent = parent;
+            }
+
+            // Searches in the paper's sense: clockwise (decreasing direction index) for the first
+            // neighbor, counterclockwise (increasing index) along the border. Outer borders are then
+            // followed in the same sense as traceBorder, with the same steps from the same start.
+            int firstDir = -1;
+            for (int k = 0; k < 8; k++) {
+                int d = (fromDir - k + 8) % 8;
+                if (f(i + dy[d], j + dx[d]) != 0) {
+                    firstDir = d;
+                    break;
+                }
+            }
+
+            if (firstDir < 0) {
+                f(i, j) = -nbd;
+            }
+            else {
+                Point p1(j + dx[firstDir], i + dy[firstDir]);
+                Point p0(j, i);
+                Point p3 = p0;
+                int backDir = firstDir;
+                while (true) {
+                    int nextDir = -1;
+                    bool eastExamined = false;
+                    for (int k = 1; k <= 8; k++) {
+                        int d = (backDir + k) % 8;
+                        if (f(p3.y + dy[d], p3.x + dx[d]) != 0) {
+                            nextDir = d;
+                            break;
+                        }
+                        if (d == EAST_INDEX) {
+                            eastExamined = true;
+                        }
+                    }
+
+                    if (eastExamined) {
+                        f(p3.y, p3.x) = -nbd;
+                    }
+                    else if (f(p3.y, p3.x) == 1) {
+                        f(p3.y, p3.x) = nbd;
+                    }
+
+                    border.chainCode.directions.push_back(static_cast<Direction>(nextDir));
+                    Point p4(p3.x + dx[nextDir], p3.y + dy[nextDir]);
+                    if (p4 == p0 && p3 == p1) {
+                        break;
+                    }
+                    backDir = (nextDir + 4) % 8;
+                    p3 = p4;
+                }
+            }
+            border.chainCode.length = border.chainCode.directions.size();
+            borders.push_back(border);
+
+            if (f(i, j) != 1) {
+                lnbd = abs(f(i, j));
+            }
+        }
+    }
+    return borders;
+}
+
+void testAllBorders() {
+    char fname[MAX_PATH];
+    while (openFileDlg(fname)) {
+        Mat_<uchar> src = imread(fname, IMREAD_GRAYSCALE);
+        if (src.empty()) {
+            printf("Could not open or find the image\n");
+            continue;
+        }
+
+        double t = (double)getTickCount();
+        vector<TracedBorder> borders = traceAllBorders(src);
+        t = ((double)getTickCount() - t) / getTickFrequency() * 1000;
+
+        int holes = 0;
+        Mat result;
+        cvtColor(src, result, COLOR_GRAY2BGR);
+        for (size_t b = 0; b < borders.size(); b++) {
+            const TracedBorder& border = borders[b];
+            holes += border.isHole ? 1 : 0;
+            printf("Border %d: %s, parent %d, start (%d, %d), length %u\n", (int)b, border.isHole ? "hole" : "outer",
+                border.parent, border.chainCode.start.x, border.chainCode.start.y, border.chainCode.length);
+
+            Vec3b color = border.isHole ? Vec3b(0, 255, 0) : Vec3b(0, 0, 255);
+            Point p = border.chainCode.start;
+            result.at<Vec3b>(p) = color;
+            for (size_t i = 0; i < border.chainCode.length; i++) {
+                p = getNextPoint(p, border.chainCode.directions[i]);
+                result.at<Vec3b>(p) = color;
+            }
+        }
+        printf("%d outer borders, %d holes in %.2f ms\n", (int)borders.size() - holes, holes, t);
+
+        imshow("Original Image", src);
+        imshow("Outer borders (red) and holes (green)", result);
+        waitKey(0);
+        destroyAllWindows();
+    }
+}
+
+// nextDirection[mask][prevDir]: first object neighbor in getNextDirection's search order, 8 if none
+struct DirectionTable {
+    uchar nextDirection[256][8];
+
+    DirectionTable() {
+        for (int mask = 0; mask < 256; mask++) {
+            for (int prevDir = 0; prevDir < 8; prevDir++) {
+                int startDir = prevDir % 2 == 0 ? (prevDir + 7) % 8 : (prevDir + 6) % 8;
+                nextDirection[mask][prevDir] = 8;
+                for (int i = 0; i < 8; i++) {
+                    int dir = (startDir + i) % 8;
+                    if (mask & (1 << dir)) {
+                        nextDirection[mask][prevDir] = (uchar)dir;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+};
+
+static const DirectionTable directionTable;
+
+void FastBorderTracer::setDeltas() {
+    const int dx[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+    const int dy[8] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+    for (int d = 0; d < 8; d++) {
+        delta[d] = dy[d] * (int)padded.step[0] + dx[d];
+    }
+}
+
+FastBorderTracer::FastBorderTracer(const Mat_<uchar>& image) : padded(Mat_<uchar>::zeros(image.rows + 2, image.cols + 2)) {
+    for (int y = 0; y < image.rows; y++) {
+        const uchar* in = image[y];
+        uchar* out = padded[y + 1] + 1;
+        for (int x = 0; x < image.cols; x++) {
+            out[x] = in[x] == 0;
+        }
+    }
+    setDeltas();
+}
+
+FastBorderTracer::FastBorderTracer(const Mat& labeledImg, int label, Rect region)
+    : padded(Mat_<uchar>::zeros(region.height + 2, region.width + 2)) {
+    CV_Assert(labeledImg.type() == CV_8UC1 || labeledImg.type() == CV_32SC1);
+    for (int y = 0; y < region.height; y++) {
+        uchar* out = padded[y + 1] + 1;
+        if (labeledImg.depth() == CV_8U) {
+            const uchar* in = labeledImg.ptr<uchar>(region.y + y) + region.x;
+            for (int x = 0; x < region.width; x++) {
+                out[x] = in[x] == label;
+            }
+        }
+        else {
+            const int* in = labeledImg.ptr<int>(region.y + y) + region.x;
+            for (int x = 0; x < region.width; x++) {
+                out[x] = in[x] == label;
+            }
+        }
+    }
+    setDeltas();
+}
+
+const uchar* FastBorderTracer::step(const uchar* current, int& dir) const {
+    int mask = current[delta[0]] | current[delta[1]] << 1 | current[delta[2]] << 2 | current[delta[3]] << 3 |
+        current[delta[4]] << 4 | current[delta[5]] << 5 | current[delta[6]] << 6 | current[delta[7]] << 7;
+    int next = directionTable.nextDirection[mask][dir];
+    // A single pixel object has no neighbor to move to
+    if (next == 8) {
+        return NULL;
+    }
+    dir = next;
+    return current + delta[next];
+}
+
+ChainCode FastBorderTracer::trace(Point start) const {
+    ChainCode chainCode;
+    chainCode.start = start;
+
+    const uchar* p0 = &padded(start.y + 1, start.x + 1);
+    const uchar* p1 = NULL;
+    const uchar* current = p0;
+    int dir = EAST;
+
+    while (true) {
+        const uchar* nextPixel = step(current, dir);
+        if (nextPixel == NULL) {
+            break;
+        }
+        if (p1 == NULL) {
+            p1 = nextPixel;
+        }
+        else if (current == p0 && nextPixel == p1) {
             break;
         }
 
-    } while (currentPoint.x >= 0 && currentPoint.x < binaryImg.cols &&
-        currentPoint.y >= 0 && currentPoint.y < binaryImg.rows);
+        chainCode.directions.push_back(static_cast<Direction>(dir));
+        current = nextPixel;
+    }
 
     chainCode.length = chainCode.directions.size();
+    return chainCode;
+}
+
+size_t FastBorderTracer::traceSteps(Point start, vector<uchar>& steps) const {
+    const uchar* p0 = &padded(start.y + 1, start.x + 1);
+    const uchar* p1 = NULL;
+    const uchar* current = p0;
+    int dir = EAST;
+    size_t length = 0;
 
+    while (true) {
+        const uchar* nextPixel = step(current, dir);
+        if (nextPixel == NULL) {
+            break;
+        }
+        if (p1 == NULL) {
+            p1 = nextPixel;
+        }
+        else if (current == p0 && nextPixel == p1) {
+            break;
+        }
+
+        steps.push_back((uchar)dir);
+        length++;
+        current = nextPixel;
+    }
+    return length;
+}
+
+ChainCode ContourArena::chainCode(int label) const {
+    ChainCode chainCode;
+    chainCode.start = start[label];
+    chainCode.length = length(label);
+    chainCode.directions.resize(chainCode.length);
+    const uchar* steps = directions(label);
+    for (unsigned int i = 0; i < chainCode.length; i++) {
+        chainCode.directions[i] = static_cast<Direction>(steps[i]);
+    }
     return chainCode;
 }
 
+ContourArena traceLabeledContours(const Mat& labeledImg, const vector<ComponentStats>& stats) {
+    CV_Assert(labeledImg.type() == CV_8UC1 || labeledImg.type() == CV_32SC1);
+    const int count = (int)stats.size();
+
+    ContourArena arena;
+    arena.start.assign(count, Point(-1, -1));
+    arena.offset.assign(count + 1, 0);
+    if (count <= 1) {
+        return arena;
+    }
+
+    // Each object is traced once inside its own bounding box (one padded copy of the box per
+    // object). Labels are split into contiguous ranges whose steps go back to back into one scratch
+    // buffer per range; after the prefix sum of the lengths, each range is one copy into the arena.
+    const int stripes = max(1, min(count - 1, getNumThreads() * 4));
+    vector<vector<uchar>> stripeSteps(stripes);
+    vector<size_t> lengths(count, 0);
+    parallel_for_(Range(0, stripes), [&](const Range& range) {
+        for (int s = range.start; s < range.end; s++) {
+            int labelStart = 1 + (int)((long long)(count - 1) * s / stripes);
+            int labelEnd = 1 + (int)((long long)(count - 1) * (s + 1) / stripes);
+            for (int label = labelStart; label < labelEnd; label++) {
+                const ComponentStats& object = stats[label];
+                if (object.area == 0) {
+                    continue;
+                }
+                Rect box = object.boundingBox();
+                lengths[label] = FastBorderTracer(labeledImg, label, box).traceSteps(object.start - box.tl(), stripeSteps[s]);
+            }
+        }
+        });
+
+    for (int label = 1; label < count; label++) {
+        arena.start[label] = stats[label].start;
+        arena.offset[label + 1] = arena.offset[label] + lengths[label];
+    }
+    arena.steps.resize(arena.offset[count]);
+
+    parallel_for_(Range(0, stripes), [&](const Range& range) {
+        for (int s = range.start; s < range.end; s++) {
+            int labelStart = 1 + (int)((long long)(count - 1) * s / stripes);
+            if (!stripeSteps[s].empty()) {
+                memcpy(arena.steps.data() + arena.offset[labelStart], stripeSteps[s].data(), stripeSteps[s].size());
+            }
+            vector<uchar>().swap(stripeSteps[s]);
+        }
+        });
+    return arena;
+}
+
+void testLabeledContours() {
+    char fname[MAX_PATH];
+    while (openFileDlg(fname)) {
+        Mat_<uchar> src = imread(fname, IMREAD_GRAYSCALE);
+        if (src.empty()) {
+            printf("Could not open or find the image\n");
+            continue;
+        }
+
+        Mat_<int> labels;
+        vector<ComponentStats> stats;
+        int count = labelBinaryImage(src, labels, &stats);
+
+        double t = (double)getTickCount();
+        ContourArena arena = traceLabeledContours(labels, stats);
+        t = ((double)getTickCount() - t) / getTickFrequency() * 1000;
+        printf("%d objects, %zu contour steps traced in %.2f ms\n", count, arena.steps.size(), t);
+
+        Mat result;
+        cvtColor(src, result, COLOR_GRAY2BGR);
+        for (int label = 1; label <= count; label++) {
+            Vec3b color((uchar)(label * 67), (uchar)(label * 131), (uchar)(255 - label * 29));
+            Point p = arena.start[label];
+            result.at<Vec3b>(p) = color;
+            const uchar* steps = arena.directions(label);
+            for (unsigned int i = 0; i < arena.length(label); i++) {
+                p = getNextPoint(p, static_cast<Direction>(steps[i]));
+                result.at<Vec3b>(p) = color;
+            }
+        }
+
+        imshow("Original Image", src);
+        imshow("Object contours", result);
+        waitKey(0);
+        destroyAllWindows();
+    }
+}
+
 ChainCode getChainedCodeDerivative(const ChainCode& chainCode) {
     ChainCode derivative;
     derivative.start = chainCode.start;
@@ -225,6 +613,8 @@ void testChainCode() {
     }
     printf("\n\n");
 
+    printChainCodeAnalysis(chainCode);
+
     system("pause");
 }
 
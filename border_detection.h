@@ -3,6 +3,7 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <vector>
+#include "labeling.h"
 
 using namespace cv;
 using namespace std;
@@ -27,8 +28,63 @@ struct ChainCode {
 Point getNextPoint(const Point& current, Direction dir);
 Direction getNextDirection(const Mat_<uchar>& image, Point current, Direction prevDir);
 void drawContour();
+// Closed border of the object whose first pixel in raster order is start (object pixels are 0),
+// each border step is stored once and the last one leads back to start
+ChainCode traceBorder(const Mat_<uchar>& image, Point start);
 ChainCode getChainCode(const Mat_<uchar>& image);
-ChainCode getChainCodeDerivative(const ChainCode& chainCode);
+
+// Same chains as traceBorder, traced on a copy with a one pixel background frame: neighbors are
+// read through pointer deltas without bounds checks, and the next direction is looked up from
+// the 8-neighborhood mask and the previous direction. Start points are in image coordinates.
+class FastBorderTracer {
+    Mat_<uchar> padded;
+    int delta[8];
+    void setDeltas();
+    // Pixel reached from current leaving in a direction after dir, or NULL for a lone pixel
+    const uchar* step(const uchar* current, int& dir) const;
+public:
+    // Object pixels are 0, as for traceBorder
+    explicit FastBorderTracer(const Mat_<uchar>& image);
+    // Object pixels are those of region (CV_8UC1 or CV_32SC1 label map) equal to label; start
+    // points are then relative to the region
+    FastBorderTracer(const Mat& labeledImg, int label, Rect region);
+    ChainCode trace(Point start) const;
+    // Same walk, appending the steps to a caller buffer as direction bytes; returns their number
+    size_t traceSteps(Point start, vector<uchar>& steps) const;
+};
+
+// Chain codes of all objects of a label map, indexed by label. The steps of every object are
+// stored back to back in one arena; those of label l are steps[offset[l] .. offset[l + 1]).
+struct ContourArena {
+    vector<Point> start;
+    vector<size_t> offset;
+    vector<uchar> steps;
+
+    unsigned int length(int label) const { return (unsigned int)(offset[label + 1] - offset[label]); }
+    const uchar* directions(int label) const { return steps.data() + offset[label]; }
+    ChainCode chainCode(int label) const;
+};
+
+// Traces every labeled object in parallel, one task per object, using the bounding box and
+// start pixel recorded by the labeling (stats indexed by label, entry 0 is the background)
+ContourArena traceLabeledContours(const Mat& labeledImg, const vector<ComponentStats>& stats);
+void testLabeledContours();
+
+// One border found by traceAllBorders. parent indexes the enclosing border in the same result,
+// -1 when the border lies directly on the image background.
+struct TracedBorder {
+    ChainCode chainCode;
+    bool isHole;
+    int parent;
+};
+
+// Suzuki-Abe border following: every outer border and hole border of the objects (pixels 0)
+// in one raster scan, in the order they are met, closed like traceBorder. The object is always
+// on the left of the walk: outer borders go counterclockwise on screen and give the same chain
+// as traceBorder from their start pixel, hole borders go clockwise.
+vector<TracedBorder> traceAllBorders(const Mat_<uchar>& image);
+void testAllBorders();
+ChainCode getChainedCodeDerivative(const ChainCode& chainCode);
 void drawImageContour(const Mat_<uchar>& image, const ChainCode& chainCode, Point startPoint);
 void testChainCode();
 void reconstructFromFile();
\ No newline at end of file
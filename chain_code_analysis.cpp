@@ -0,0 +1,153 @@
+#include "stdafx.h"
+#include "chain_code_analysis.h"
+
+double chainPerimeter(const ChainCode& chainCode) {
+    unsigned int diagonal = 0;
+    for (unsigned int i = 0; i < chainCode.length; i++) {
+        diagonal += chainCode.directions[i] & 1;
+    }
+    return (chainCode.length - diagonal) + diagonal * sqrt(2.0);
+}
+
+double chainArea(const ChainCode& chainCode) {
+    return fabs(chainSignedArea(chainCode));
+}
+
+double chainSignedArea(const ChainCode& chainCode) {
+    const int dx[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+    const int dy[8] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+
+    // Relative to the start point: sum of x_i * dy_i - y_i * dx_i over the steps
+    long long twice = 0;
+    int x = 0, y = 0;
+    for (unsigned int i = 0; i < chainCode.length; i++) {
+        int d = chainCode.directions[i];
+        twice += (long long)x * dy[d] - (long long)y * dx[d];
+        x += dx[d];
+        y += dy[d];
+    }
+    // y grows downwards, so a counterclockwise walk on screen gives a negative sum
+    return -(double)twice / 2;
+}
+
+void curvatureHistogram(const ChainCode& chainCode, int histogram[8]) {
+    for (int d = 0; d < 8; d++) {
+        histogram[d] = 0;
+    }
+    if (chainCode.length == 0) {
+        return;
+    }
+    ChainCode derivative = getChainedCodeDerivative(chainCode);
+    for (unsigned int i = 0; i < derivative.length; i++) {
+        histogram[derivative.directions[i]]++;
+    }
+}
+
+vector<int> findChainCorners(const ChainCode& chainCode, int halfWindow, int minTurn) {
+    vector<int> corners;
+    const int n = (int)chainCode.length;
+    if (n < 2) {
+        return corners;
+    }
+
+    // derivative[i] is the turn made at point i + 1
+    ChainCode derivative = getChainedCodeDerivative(chainCode);
+    vector<int> turn(n);
+    for (int i = 0; i < n; i++) {
+        turn[i] = signedTurn(derivative.directions[i]);
+    }
+
+    // Sliding window sums of the turn, wrapping around the closed border
+    vector<int> total(n);
+    int sum = 0;
+    for (int k = -halfWindow; k <= halfWindow; k++) {
+        sum += turn[((k % n) + n) % n];
+    }
+    for (int i = 0; i < n; i++) {
+        total[i] = sum;
+        sum += turn[((i + halfWindow + 1) % n + n) % n] - turn[((i - halfWindow) % n + n) % n];
+    }
+
+    // Ties in the window sum are broken by the turn at the point itself, then by position
+    auto strength = [&](int i) { return abs(total[i]) * 8 + abs(turn[i]); };
+    for (int i = 0; i < n; i++) {
+        if (abs(total[i]) < minTurn) {
+            continue;
+        }
+        bool isMax = true;
+        for (int k = 1; k <= halfWindow && isMax; k++) {
+            isMax = strength(i) >= strength((i + k) % n) && strength(i) > strength((i - k + n) % n);
+        }
+        if (isMax) {
+            corners.push_back((i + 1) % n);
+        }
+    }
+    return corners;
+}
+
+vector<uchar> shapeNumber(const ChainCode& chainCode) {
+    ChainCode derivative = getChainedCodeDerivative(chainCode);
+    const int n = (int)derivative.length;
+    vector<uchar> code(n);
+    if (n == 0) {
+        return code;
+    }
+    for (int i = 0; i < n; i++) {
+        code[i] = (uchar)derivative.directions[i];
+    }
+
+    // Booth's least rotation
+    vector<int> failure(2 * n, -1);
+    int k = 0;
+    for (int j = 1; j < 2 * n; j++) {
+        uchar c = code[j % n];
+        int i = failure[j - k - 1];
+        while (i != -1 && c != code[(k + i + 1) % n]) {
+            if (c < code[(k + i + 1) % n]) {
+                k = j - i - 1;
+            }
+            i = failure[i];
+        }
+        if (c != code[(k + i + 1) % n]) {
+            if (c < code[k % n]) {
+                k = j;
+            }
+            failure[j - k] = -1;
+        }
+        else {
+            failure[j - k] = i + 1;
+        }
+    }
+
+    rotate(code.begin(), code.begin() + k % n, code.end());
+    return code;
+}
+
+void printChainCodeAnalysis(const ChainCode& chainCode) {
+    printf("Perimeter: %.2f\n", chainPerimeter(chainCode));
+    printf("Area (border polygon): %.1f\n", chainArea(chainCode));
+
+    int histogram[8];
+    curvatureHistogram(chainCode, histogram);
+    printf("Curvature histogram:");
+    for (int d = 0; d < 8; d++) {
+        printf(" %d:%d", signedTurn(d), histogram[d]);
+    }
+    printf("\n");
+
+    vector<int> corners = findChainCorners(chainCode);
+    printf("Corners (%d):", (int)corners.size());
+    for (size_t i = 0; i < corners.size(); i++) {
+        printf(" %d", corners[i]);
+    }
+    printf("\n");
+
+    vector<uchar> shape = shapeNumber(chainCode);
+    printf("Shape number:\n");
+    for (size_t i = 0; i < shape.size(); i++) {
+        printf("%d", shape[i]);
+        if ((i + 1) % 50 == 0) printf("\n");
+        else if ((i + 1) % 10 == 0) printf(" ");
+    }
+    printf("\n\n");
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+#include "border_detection.h"
+
+using namespace std;
+
+// Shape measurements read straight from a closed chain code, each in O(length)
+
+// Even steps count 1, diagonal steps sqrt(2)
+double chainPerimeter(const ChainCode& chainCode);
+
+// Shoelace area of the polygon through the border pixel centers
+double chainArea(const ChainCode& chainCode);
+// Same area with a sign: positive when the chain runs counterclockwise on screen (like the outer
+// borders of traceBorder), negative when it runs clockwise
+double chainSignedArea(const ChainCode& chainCode);
+
+// Signed turn of a derivative code: 0..4 turn left (counterclockwise), 5..7 are -3..-1
+inline int signedTurn(int derivative) {
+    return derivative > 4 ? derivative - 8 : derivative;
+}
+
+// histogram[d] = number of border points where the derivative code is d
+void curvatureHistogram(const ChainCode& chainCode, int histogram[8]);
+
+// Border points (index k = point reached after k steps) where the total turn over a window of
+// 2 * halfWindow + 1 derivative codes is at least minTurn in magnitude and locally maximal
+vector<int> findChainCorners(const ChainCode& chainCode, int halfWindow = 1, int minTurn = 2);
+
+// Derivative code rotated to its lexicographically smallest circular shift
+vector<uchar> shapeNumber(const ChainCode& chainCode);
+
+void printChainCodeAnalysis(const ChainCode& chainCode);
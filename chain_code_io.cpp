@@ -0,0 +1,204 @@
+#include "stdafx.h"
+#include "chain_code_io.h"
+#include "chain_code_raster.h"
+
+static const int CHAIN_FILE_VERSION = 1;
+
+void packDirections(const Direction* directions, unsigned int length, uchar* bits) {
+    memset(bits, 0, packedChainBytes(length));
+    unsigned int k = 0;
+    // 8 steps fill exactly 3 bytes
+    for (; k + 8 <= length; k += 8) {
+        unsigned int group = 0;
+        for (int i = 0; i < 8; i++) {
+            group |= (unsigned int)directions[k + i] << (3 * i);
+        }
+        uchar* out = bits + k / 8 * 3;
+        out[0] = (uchar)group;
+        out[1] = (uchar)(group >> 8);
+        out[2] = (uchar)(group >> 16);
+    }
+    for (; k < length; k++) {
+        size_t bit = (size_t)k * 3;
+        unsigned int value = (unsigned int)directions[k] << (bit & 7);
+        bits[bit >> 3] |= (uchar)value;
+        if (value > 0xFF) {
+            bits[(bit >> 3) + 1] |= (uchar)(value >> 8);
+        }
+    }
+}
+
+void unpackDirections(const uchar* bits, unsigned int length, Direction* directions) {
+    unsigned int k = 0;
+    for (; k + 8 <= length; k += 8) {
+        const uchar* in = bits + k / 8 * 3;
+        unsigned int group = in[0] | (in[1] << 8) | (in[2] << 16);
+        for (int i = 0; i < 8; i++) {
+            directions[k + i] = static_cast<Direction>((group >> (3 * i)) & 7);
+        }
+    }
+    size_t bytes = packedChainBytes(length);
+    for (; k < length; k++) {
+        size_t bit = (size_t)k * 3;
+        size_t byte = bit >> 3;
+        unsigned int value = bits[byte];
+        if (byte + 1 < bytes) {
+            value |= bits[byte + 1] << 8;
+        }
+        directions[k] = static_cast<Direction>((value >> (bit & 7)) & 7);
+    }
+}
+
+PackedChainCode packChainCode(const ChainCode& chainCode) {
+    PackedChainCode packed;
+    packed.start = chainCode.start;
+    packed.length = chainCode.length;
+    packed.bits.resize(packedChainBytes(chainCode.length));
+    if (chainCode.length > 0) {
+        packDirections(chainCode.directions.data(), chainCode.length, packed.bits.data());
+    }
+    return packed;
+}
+
+ChainCode unpackChainCode(const PackedChainCode& packed) {
+    ChainCode chainCode;
+    chainCode.start = packed.start;
+    chainCode.length = packed.length;
+    chainCode.directions.resize(packed.length);
+    if (packed.length > 0) {
+        unpackDirections(packed.bits.data(), packed.length, chainCode.directions.data());
+    }
+    return chainCode;
+}
+
+bool writeChainCodeFile(const char* fileName, const vector<ChainCode>& chainCodes) {
+    BufferedWriter out(fileName);
+    if (!out.isOpen()) {
+        return false;
+    }
+
+    int header[4] = { 0, CHAIN_FILE_VERSION, (int)chainCodes.size(), 0 };
+    memcpy(header, "CHNC", 4);
+    out.write(header, sizeof(header));
+
+    unsigned long long offset = 0;
+    for (const ChainCode& c : chainCodes) {
+        ChainCodeEntry entry = { c.start.x, c.start.y, c.length, 0, offset };
+        out.write(&entry, sizeof(entry));
+        offset += packedChainBytes(c.length);
+    }
+
+    vector<uchar> bits;
+    for (const ChainCode& c : chainCodes) {
+        bits.resize(packedChainBytes(c.length));
+        if (c.length > 0) {
+            packDirections(c.directions.data(), c.length, bits.data());
+            out.write(bits.data(), bits.size());
+        }
+    }
+    return out.close();
+}
+
+bool ChainCodeFile::open(const char* fileName) {
+    entries = NULL;
+    packed = NULL;
+    contours = 0;
+    if (!file.open(fileName)) {
+        return false;
+    }
+
+    const int* header = (const int*)file.data();
+    if (file.size() < 4 * sizeof(int) || memcmp(header, "CHNC", 4) != 0 || header[1] != CHAIN_FILE_VERSION || header[2] < 0) {
+        file.close();
+        return false;
+    }
+    size_t count = (size_t)header[2];
+    size_t dataStart = 4 * sizeof(int) + count * sizeof(ChainCodeEntry);
+    if (file.size() < dataStart) {
+        file.close();
+        return false;
+    }
+
+    const ChainCodeEntry* table = (const ChainCodeEntry*)(file.data() + 4 * sizeof(int));
+    size_t dataSize = file.size() - dataStart;
+    for (size_t i = 0; i < count; i++) {
+        if (table[i].offset > dataSize || packedChainBytes(table[i].length) > dataSize - table[i].offset) {
+            file.close();
+            return false;
+        }
+    }
+
+    entries = table;
+    packed = file.data() + dataStart;
+    contours = (int)count;
+    return true;
+}
+
+ChainCode ChainCodeFile::chainCode(int i) const {
+    ChainCode chainCode;
+    chainCode.start = start(i);
+    chainCode.length = length(i);
+    chainCode.directions.resize(chainCode.length);
+    if (chainCode.length > 0) {
+        unpackDirections(bits(i), chainCode.length, chainCode.directions.data());
+    }
+    return chainCode;
+}
+
+void testChainCodeArchive() {
+    char fname[MAX_PATH];
+    while (openFileDlg(fname)) {
+        Mat_<uchar> src = imread(fname, IMREAD_GRAYSCALE);
+        if (src.empty()) {
+            printf("Could not open or find the image\n");
+            continue;
+        }
+
+        vector<TracedBorder> borders = traceAllBorders(src);
+        vector<ChainCode> chainCodes;
+        size_t steps = 0, archiveBytes = 4 * sizeof(int);
+        for (const TracedBorder& border : borders) {
+            chainCodes.push_back(border.chainCode);
+            steps += border.chainCode.length;
+            archiveBytes += sizeof(ChainCodeEntry) + packedChainBytes(border.chainCode.length);
+        }
+
+        string archiveName = string(fname) + ".chc";
+        if (!writeChainCodeFile(archiveName.c_str(), chainCodes)) {
+            printf("Could not write %s\n", archiveName.c_str());
+            continue;
+        }
+
+        ChainCodeFile archive;
+        double t = (double)getTickCount();
+        if (!archive.open(archiveName.c_str())) {
+            printf("Could not read %s\n", archiveName.c_str());
+            continue;
+        }
+        Mat_<uchar> outline(src.size(), (uchar)255);
+        Mat_<uchar> filled(src.size(), (uchar)255);
+        for (int i = 0; i < archive.count(); i++) {
+            ChainCode chainCode = archive.chainCode(i);
+            drawChainCode(outline, chainCode, 0, false);
+            // Borders come parents first: a hole is cleared and its border redrawn
+            if (borders[i].isHole) {
+                drawChainCode(filled, chainCode, 255, true);
+                drawChainCode(filled, chainCode, 0, false);
+            }
+            else {
+                drawChainCode(filled, chainCode, 0, true);
+            }
+        }
+        t = ((double)getTickCount() - t) / getTickFrequency() * 1000;
+
+        printf("%d contours, %zu steps\n", archive.count(), steps);
+        printf("vector<Direction>: %zu bytes, archive %s: %zu bytes\n", steps * sizeof(Direction), archiveName.c_str(), archiveBytes);
+        printf("Mapped and decoded in %.2f ms\n", t);
+
+        imshow("Original Image", src);
+        imshow("Contours read from the archive", outline);
+        imshow("Objects filled from the archive", filled);
+        waitKey(0);
+        destroyAllWindows();
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <opencv2/core/core.hpp>
+#include <vector>
+#include "border_detection.h"
+#include "common.h"
+
+using namespace cv;
+using namespace std;
+
+// Chain code with 3 bits per step: step k occupies bits 3k..3k+2 of the byte stream,
+// least significant bit first
+struct PackedChainCode {
+    Point start;
+    unsigned int length = 0;
+    vector<uchar> bits;
+};
+
+inline size_t packedChainBytes(unsigned int length) {
+    return ((size_t)length * 3 + 7) / 8;
+}
+
+void packDirections(const Direction* directions, unsigned int length, uchar* bits);
+void unpackDirections(const uchar* bits, unsigned int length, Direction* directions);
+PackedChainCode packChainCode(const ChainCode& chainCode);
+ChainCode unpackChainCode(const PackedChainCode& packed);
+
+// Chain code archive (.chc): a 16 byte header ("CHNC", version, contour count, 0), one
+// ChainCodeEntry per contour, then the packed steps of all contours; offsets are relative to
+// the start of the packed data
+struct ChainCodeEntry {
+    int x, y;
+    unsigned int length;
+    unsigned int reserved;
+    unsigned long long offset;
+};
+
+bool writeChainCodeFile(const char* fileName, const vector<ChainCode>& chainCodes);
+
+// Archive read in place from a memory mapping; bits(i) points into the mapped file
+class ChainCodeFile {
+    MappedFile file;
+    const ChainCodeEntry* entries;
+    const uchar* packed;
+    int contours;
+public:
+    ChainCodeFile() : entries(NULL), packed(NULL), contours(0) {}
+    bool open(const char* fileName);
+    int count() const { return contours; }
+    Point start(int i) const { return Point(entries[i].x, entries[i].y); }
+    unsigned int length(int i) const { return entries[i].length; }
+    const uchar* bits(int i) const { return packed + entries[i].offset; }
+    ChainCode chainCode(int i) const;
+};
+
+void testChainCodeArchive();
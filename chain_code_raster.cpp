@@ -0,0 +1,119 @@
+#include "stdafx.h"
+#include "chain_code_raster.h"
+#include <algorithm>
+
+static const int dx[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+static const int dy[8] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+
+static Rect chainBoundingBox(const ChainCode& chainCode) {
+    int x = chainCode.start.x, y = chainCode.start.y;
+    int minX = x, maxX = x, minY = y, maxY = y;
+    for (unsigned int i = 0; i < chainCode.length; i++) {
+        x += dx[chainCode.directions[i]];
+        y += dy[chainCode.directions[i]];
+        minX = min(minX, x);
+        maxX = max(maxX, x);
+        minY = min(minY, y);
+        maxY = max(maxY, y);
+    }
+    return Rect(minX, minY, maxX - minX + 1, maxY - minY + 1);
+}
+
+static void drawOutline(Mat_<uchar>& dst, const ChainCode& chainCode, uchar value, Rect box) {
+    Point p = chainCode.start;
+    if ((box & Rect(0, 0, dst.cols, dst.rows)) == box) {
+        // Entirely inside: walk with pointer deltas
+        int delta[8];
+        for (int d = 0; d < 8; d++) {
+            delta[d] = dy[d] * (int)dst.step[0] + dx[d];
+        }
+        uchar* pixel = &dst(p.y, p.x);
+        *pixel = value;
+        for (unsigned int i = 0; i < chainCode.length; i++) {
+            pixel += delta[chainCode.directions[i]];
+            *pixel = value;
+        }
+        return;
+    }
+
+    if (p.x >= 0 && p.x < dst.cols && p.y >= 0 && p.y < dst.rows) {
+        dst(p.y, p.x) = value;
+    }
+    for (unsigned int i = 0; i < chainCode.length; i++) {
+        p.x += dx[chainCode.directions[i]];
+        p.y += dy[chainCode.directions[i]];
+        if (p.x >= 0 && p.x < dst.cols && p.y >= 0 && p.y < dst.rows) {
+            dst(p.y, p.x) = value;
+        }
+    }
+}
+
+// The border is the polygon through the pixel centers. A step from row y to row y +- 1 crosses
+// the scanline of the lower row index at the x of the point on that row (half-open rule), so
+// sorted crossings pair up into the spans inside the polygon.
+static void fillInterior(Mat_<uchar>& dst, const ChainCode& chainCode, uchar value, Rect box,
+    vector<int>& rowStart, vector<int>& crossings) {
+    rowStart.assign(box.height + 1, 0);
+    Point p = chainCode.start;
+    for (unsigned int i = 0; i < chainCode.length; i++) {
+        int d = chainCode.directions[i];
+        if (dy[d] != 0) {
+            rowStart[min(p.y, p.y + dy[d]) - box.y + 1]++;
+        }
+        p.x += dx[d];
+        p.y += dy[d];
+    }
+    for (int r = 0; r < box.height; r++) {
+        rowStart[r + 1] += rowStart[r];
+    }
+
+    crossings.resize(rowStart[box.height]);
+    vector<int> next(rowStart.begin(), rowStart.end() - 1);
+    p = chainCode.start;
+    for (unsigned int i = 0; i < chainCode.length; i++) {
+        int d = chainCode.directions[i];
+        if (dy[d] != 0) {
+            int x = dy[d] < 0 ? p.x + dx[d] : p.x;
+            crossings[next[min(p.y, p.y + dy[d]) - box.y]++] = x;
+        }
+        p.x += dx[d];
+        p.y += dy[d];
+    }
+
+    for (int r = 0; r < box.height; r++) {
+        int y = box.y + r;
+        if (y < 0 || y >= dst.rows) {
+            continue;
+        }
+        int* first = crossings.data() + rowStart[r];
+        int* last = crossings.data() + rowStart[r + 1];
+        sort(first, last);
+        uchar* row = dst[y];
+        for (int* c = first; c + 1 < last; c += 2) {
+            int x0 = max(c[0], 0), x1 = min(c[1], dst.cols - 1);
+            if (x0 <= x1) {
+                memset(row + x0, value, x1 - x0 + 1);
+            }
+        }
+    }
+}
+
+void drawChainCodes(Mat_<uchar>& dst, const vector<ChainCode>& chainCodes, uchar value, bool fill) {
+    vector<int> rowStart, crossings;
+    for (const ChainCode& chainCode : chainCodes) {
+        Rect box = chainBoundingBox(chainCode);
+        if (fill) {
+            fillInterior(dst, chainCode, value, box, rowStart, crossings);
+        }
+        drawOutline(dst, chainCode, value, box);
+    }
+}
+
+void drawChainCode(Mat_<uchar>& dst, const ChainCode& chainCode, uchar value, bool fill) {
+    vector<int> rowStart, crossings;
+    Rect box = chainBoundingBox(chainCode);
+    if (fill) {
+        fillInterior(dst, chainCode, value, box, rowStart, crossings);
+    }
+    drawOutline(dst, chainCode, value, box);
+}
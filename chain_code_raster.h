@@ -0,0 +1,15 @@
+#pragma once
+#include <opencv2/core/core.hpp>
+#include <vector>
+#include "border_detection.h"
+
+using namespace cv;
+using namespace std;
+
+// Draws a closed chain code into dst (CV_8UC1, allocated by the caller). The outline sets the
+// border pixels; with fill, every pixel enclosed by the border is set as well, using a scanline
+// parity fill over the vertical steps of the chain. Pixels outside dst are skipped.
+void drawChainCode(Mat_<uchar>& dst, const ChainCode& chainCode, uchar value, bool fill);
+
+// Same for many chain codes, in order, sharing one scratch buffer
+void drawChainCodes(Mat_<uchar>& dst, const vector<ChainCode>& chainCodes, uchar value, bool fill);
@@ -3,6 +3,7 @@
 #include "common.h"
 #include <CommDlg.h>
 #include <ShlObj.h>
+#include <stdarg.h>
 
 FileGetter::FileGetter(char* folderin,char* ext){		
 	strcpy(folder,folderin);
@@ -58,6 +59,115 @@ char* FileGetter::getFoundFileName(){
 	return found.cFileName;
 }
 
+BufferedWriter::BufferedWriter(const char* fileName, size_t capacity) : buffer(capacity), used(0), failed(false) {
+	file = fopen(fileName, "wb");
+}
+
+BufferedWriter::~BufferedWriter() {
+	close();
+}
+
+void BufferedWriter::write(const void* data, size_t size) {
+	if (!file) {
+		return;
+	}
+	if (used + size > buffer.size()) {
+		flush();
+		if (size > buffer.size()) {
+			if (fwrite(data, 1, size, file) != size) {
+				failed = true;
+			}
+			return;
+		}
+	}
+	memcpy(&buffer[used], data, size);
+	used += size;
+}
+
+void BufferedWriter::print(const char* format, ...) {
+	char line[1024];
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+	if (length > 0) {
+		write(line, min_((size_t)length, sizeof(line) - 1));
+	}
+}
+
+bool BufferedWriter::flush() {
+	if (!file) {
+		return false;
+	}
+	if (used > 0) {
+		if (fwrite(&buffer[0], 1, used, file) != used) {
+			failed = true;
+		}
+		used = 0;
+	}
+	return !failed;
+}
+
+bool BufferedWriter::close() {
+	if (!file) {
+		return false;
+	}
+	bool ok = flush();
+	if (fclose(file) != 0) {
+		ok = false;
+	}
+	file = NULL;
+	return ok;
+}
+
+MappedFile::MappedFile() : file(INVALID_HANDLE_VALUE), mapping(NULL), view(NULL), length(0) {
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+bool MappedFile::open(const char* fileName) {
+	close();
+	file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0 || (unsigned long long)fileSize.QuadPart > (size_t)-1) {
+		close();
+		return false;
+	}
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		close();
+		return false;
+	}
+	view = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL) {
+		close();
+		return false;
+	}
+	length = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::close() {
+	if (view) {
+		UnmapViewOfFile(view);
+		view = NULL;
+	}
+	if (mapping) {
+		CloseHandle(mapping);
+		mapping = NULL;
+	}
+	if (file != INVALID_HANDLE_VALUE) {
+		CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+	}
+	length = 0;
+}
+
 
 int openFileDlg(char* fname)
 {
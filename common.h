@@ -4,6 +4,8 @@
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include <windows.h>
+#include <stdio.h>
+#include <vector>
 
 using namespace cv;
 
@@ -29,6 +31,44 @@ public:
 };
 
 
+// Output file written through a large in-memory buffer instead of one printf/fwrite per value.
+// A failed write (e.g. a full disk) is remembered and reported by flush() and close().
+class BufferedWriter {
+	FILE* file;
+	std::vector<char> buffer;
+	size_t used;
+	bool failed;
+	BufferedWriter(const BufferedWriter&);
+	BufferedWriter& operator=(const BufferedWriter&);
+public:
+	BufferedWriter(const char* fileName, size_t capacity = 1 << 20);
+	~BufferedWriter();
+	bool isOpen() const { return file != NULL; }
+	void write(const void* data, size_t size);
+	void print(const char* format, ...);
+	bool flush();
+	bool close();
+};
+
+
+// Read-only view of a whole file through a Win32 file mapping; pages are loaded on first access
+class MappedFile {
+	HANDLE file;
+	HANDLE mapping;
+	const unsigned char* view;
+	size_t length;
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+public:
+	MappedFile();
+	~MappedFile();
+	bool open(const char* fileName);
+	void close();
+	const unsigned char* data() const { return view; }
+	size_t size() const { return length; }
+};
+
+
 int openFileDlg(char* fname);
 
 int openFolderDlg(char* folderName);
@@ -0,0 +1,179 @@
+#include "stdafx.h"
+#include "contour_matching.h"
+#include "common.h"
+#include "chain_code_analysis.h"
+#include <algorithm>
+#include <opencv2/core/hal/intrin.hpp>
+
+void computeChainSignature(const ChainCode& chainCode, float signature[SIGNATURE_SIZE]) {
+    fill(signature, signature + SIGNATURE_SIZE, 0.0f);
+    ChainCode derivative = getChainedCodeDerivative(chainCode);
+    const unsigned int n = derivative.length;
+    if (n == 0) {
+        return;
+    }
+
+    // Walking the border the other way reverses the derivative sequence and negates every code,
+    // so a clockwise chain is counted as its counterclockwise twin: d -> (8 - d) % 8 and the pair
+    // (d, next) -> (-next, -d). The sense comes from the signed area, as the total turn (+-8) is
+    // ambiguous when the chain contains reversals (code 4) at one pixel wide spurs.
+    const bool clockwise = chainSignedArea(chainCode) < 0;
+
+    int single[8] = { 0 };
+    int pairs[64] = { 0 };
+    for (unsigned int i = 0; i < n; i++) {
+        int d = derivative.directions[i];
+        int next = derivative.directions[i + 1 < n ? i + 1 : 0];
+        if (clockwise) {
+            int reversed = (8 - next) % 8;
+            next = (8 - d) % 8;
+            d = reversed;
+        }
+        single[d]++;
+        pairs[d * 8 + next]++;
+    }
+    const float scale = 1.0f / n;
+    for (int d = 0; d < 8; d++) {
+        signature[d] = single[d] * scale;
+    }
+    for (int p = 0; p < 64; p++) {
+        signature[8 + p] = pairs[p] * scale;
+    }
+}
+
+void ContourIndex::reserve(int count) {
+    signatures.reserve((size_t)count * SIGNATURE_SIZE);
+    ids.reserve(count);
+}
+
+void ContourIndex::add(const ChainCode& chainCode, int id) {
+    size_t offset = signatures.size();
+    signatures.resize(offset + SIGNATURE_SIZE);
+    computeChainSignature(chainCode, &signatures[offset]);
+    ids.push_back(id);
+}
+
+static float squaredDistance(const float* a, const float* b) {
+    int i = 0;
+    float sum = 0;
+#if CV_SIMD128
+    v_float32x4 acc0 = v_setzero_f32(), acc1 = v_setzero_f32();
+    for (; i + 8 <= SIGNATURE_SIZE; i += 8) {
+        v_float32x4 d0 = v_load(a + i) - v_load(b + i);
+        v_float32x4 d1 = v_load(a + i + 4) - v_load(b + i + 4);
+        acc0 = v_muladd(d0, d0, acc0);
+        acc1 = v_muladd(d1, d1, acc1);
+    }
+    sum = v_reduce_sum(acc0 + acc1);
+#endif
+    for (; i < SIGNATURE_SIZE; i++) {
+        float d = a[i] - b[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+static bool closer(const ContourMatch& a, const ContourMatch& b) {
+    return a.distance < b.distance;
+}
+
+vector<ContourMatch> ContourIndex::query(const float signature[SIGNATURE_SIZE], int k) const {
+    const int count = size();
+    k = min(k, count);
+    vector<ContourMatch> heap;
+    if (k <= 0) {
+        return heap;
+    }
+    heap.reserve(k);
+
+    // Max-heap on distance holding the k best so far
+    for (int i = 0; i < count; i++) {
+        float distance = squaredDistance(signature, &signatures[(size_t)i * SIGNATURE_SIZE]);
+        if ((int)heap.size() < k) {
+            heap.push_back({ ids[i], distance });
+            push_heap(heap.begin(), heap.end(), closer);
+        }
+        else if (distance < heap.front().distance) {
+            pop_heap(heap.begin(), heap.end(), closer);
+            heap.back() = { ids[i], distance };
+            push_heap(heap.begin(), heap.end(), closer);
+        }
+    }
+
+    sort_heap(heap.begin(), heap.end(), closer);
+    for (ContourMatch& match : heap) {
+        match.distance = sqrt(match.distance);
+    }
+    return heap;
+}
+
+vector<ContourMatch> ContourIndex::query(const ChainCode& chainCode, int k) const {
+    float signature[SIGNATURE_SIZE];
+    computeChainSignature(chainCode, signature);
+    return query(signature, k);
+}
+
+vector<vector<ContourMatch>> ContourIndex::queryBatch(const vector<ChainCode>& chainCodes, int k) const {
+    vector<vector<ContourMatch>> results(chainCodes.size());
+    parallel_for_(Range(0, (int)chainCodes.size()), [&](const Range& range) {
+        for (int q = range.start; q < range.end; q++) {
+            results[q] = query(chainCodes[q], k);
+        }
+        });
+    return results;
+}
+
+static vector<ChainCode> outerBorders(const Mat_<uchar>& image) {
+    vector<ChainCode> chainCodes;
+    for (const TracedBorder& border : traceAllBorders(image)) {
+        if (!border.isHole) {
+            chainCodes.push_back(border.chainCode);
+        }
+    }
+    return chainCodes;
+}
+
+void testContourMatching() {
+    char fname[MAX_PATH];
+    printf("Select the image with the library objects\n");
+    if (!openFileDlg(fname)) {
+        return;
+    }
+    Mat_<uchar> library = imread(fname, IMREAD_GRAYSCALE);
+    if (library.empty()) {
+        printf("Could not open or find the image\n");
+        return;
+    }
+
+    vector<ChainCode> libraryContours = outerBorders(library);
+    ContourIndex index;
+    index.reserve((int)libraryContours.size());
+    for (int i = 0; i < (int)libraryContours.size(); i++) {
+        index.add(libraryContours[i], i);
+    }
+    printf("Library: %d objects\n", index.size());
+
+    printf("Select query images\n");
+    while (openFileDlg(fname)) {
+        Mat_<uchar> queryImg = imread(fname, IMREAD_GRAYSCALE);
+        if (queryImg.empty()) {
+            printf("Could not open or find the image\n");
+            continue;
+        }
+
+        vector<ChainCode> queries = outerBorders(queryImg);
+        double t = (double)getTickCount();
+        vector<vector<ContourMatch>> matches = index.queryBatch(queries, 3);
+        t = ((double)getTickCount() - t) / getTickFrequency() * 1000;
+
+        for (size_t q = 0; q < queries.size(); q++) {
+            printf("Object at (%d, %d):", queries[q].start.x, queries[q].start.y);
+            for (const ContourMatch& match : matches[q]) {
+                Point start = libraryContours[match.id].start;
+                printf("  (%d, %d) d=%.4f", start.x, start.y, match.distance);
+            }
+            printf("\n");
+        }
+        printf("%d queries in %.2f ms\n", (int)queries.size(), t);
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <opencv2/core/core.hpp>
+#include <vector>
+#include "border_detection.h"
+
+using namespace cv;
+using namespace std;
+
+// Signature of a closed chain code: the normalized histogram of its derivative codes followed by
+// the normalized histogram of consecutive derivative pairs. Derivatives do not depend on the
+// start point, so the signature of a digital shape is unchanged by rotations by multiples of
+// 90 degrees. A 45 degree rotation leaves a given derivative sequence as it is, but the rotated
+// shape is a different digital curve (axis steps become diagonal ones), so it does not match.
+// Clockwise chains are counted as their counterclockwise reversal, so a border gives the same
+// signature whichever sense it was traced in.
+const int SIGNATURE_SIZE = 8 + 64;
+void computeChainSignature(const ChainCode& chainCode, float signature[SIGNATURE_SIZE]);
+
+struct ContourMatch {
+    int id;
+    float distance;
+};
+
+// Signatures kept row by row in one array; queries scan it with a bounded heap (exact k-NN, L2)
+class ContourIndex {
+    vector<float> signatures;
+    vector<int> ids;
+public:
+    void add(const ChainCode& chainCode, int id);
+    void reserve(int count);
+    int size() const { return (int)ids.size(); }
+    // Best k matches, closest first
+    vector<ContourMatch> query(const ChainCode& chainCode, int k) const;
+    vector<ContourMatch> query(const float signature[SIGNATURE_SIZE], int k) const;
+    // Many queries at once, spread over the available threads
+    vector<vector<ContourMatch>> queryBatch(const vector<ChainCode>& chainCodes, int k) const;
+};
+
+void testContourMatching();
@@ -0,0 +1,114 @@
+#include "stdafx.h"
+#include "convex_hull.h"
+#include <algorithm>
+#include <cfloat>
+
+static long long cross(Point o, Point a, Point b) {
+    return (long long)(a.x - o.x) * (b.y - o.y) - (long long)(a.y - o.y) * (b.x - o.x);
+}
+
+static bool lessXY(const Point& a, const Point& b) {
+    return a.x < b.x || (a.x == b.x && a.y < b.y);
+}
+
+vector<Point> monotoneChainHull(vector<Point> points) {
+    sort(points.begin(), points.end(), lessXY);
+    points.erase(unique(points.begin(), points.end()), points.end());
+    int n = (int)points.size();
+    if (n < 3) {
+        return points;
+    }
+
+    vector<Point> hull(2 * n);
+    int k = 0;
+    for (int i = 0; i < n; i++) {
+        while (k >= 2 && cross(hull[k - 2], hull[k - 1], points[i]) <= 0) {
+            k--;
+        }
+        hull[k++] = points[i];
+    }
+    for (int i = n - 2, lower = k + 1; i >= 0; i--) {
+        while (k >= lower && cross(hull[k - 2], hull[k - 1], points[i]) <= 0) {
+            k--;
+        }
+        hull[k++] = points[i];
+    }
+    hull.resize(k - 1);
+    return hull;
+}
+
+double polygonArea(const vector<Point>& polygon) {
+    long long twice = 0;
+    int n = (int)polygon.size();
+    for (int i = 0, j = n - 1; i < n; j = i++) {
+        twice += (long long)polygon[j].x * polygon[i].y - (long long)polygon[i].x * polygon[j].y;
+    }
+    return twice / 2.0;
+}
+
+HullFeatures computeHullFeatures(const vector<Point>& contour) {
+    HullFeatures features;
+    if (contour.empty()) {
+        return features;
+    }
+
+    // Pixel (x, y) covers the square with corners (x, y) .. (x + 1, y + 1)
+    vector<Point> corners;
+    corners.reserve(4 * contour.size());
+    for (const Point& p : contour) {
+        corners.push_back(p);
+        corners.push_back(Point(p.x + 1, p.y));
+        corners.push_back(Point(p.x, p.y + 1));
+        corners.push_back(Point(p.x + 1, p.y + 1));
+    }
+    vector<Point> hull = monotoneChainHull(corners);
+    int n = (int)hull.size();
+    features.convexArea = polygonArea(hull);
+
+    // For each hull edge: j is the farthest vertex from the edge line, right and left the extreme
+    // vertices along the edge direction. All three only move forward while the edge turns.
+    double bestArea = DBL_MAX;
+    double maxFeret2 = 0;
+    double minWidth = DBL_MAX;
+    int j = 1, right = 1, left = 0;
+    for (int i = 0; i < n; i++) {
+        Point a = hull[i], b = hull[(i + 1) % n];
+        Point2d e(b.x - a.x, b.y - a.y);
+        double len = sqrt(e.x * e.x + e.y * e.y);
+        e *= 1.0 / len;
+
+        auto height = [&](int k) { return e.x * (hull[k].y - a.y) - e.y * (hull[k].x - a.x); };
+        auto along = [&](int k) { return e.x * (hull[k].x - a.x) + e.y * (hull[k].y - a.y); };
+        auto dist2 = [&](Point p, Point q) { return (double)(p.x - q.x) * (p.x - q.x) + (double)(p.y - q.y) * (p.y - q.y); };
+
+        maxFeret2 = max(maxFeret2, max(dist2(a, hull[j]), dist2(b, hull[j])));
+        while (height((j + 1) % n) > height(j)) {
+            j = (j + 1) % n;
+            maxFeret2 = max(maxFeret2, max(dist2(a, hull[j]), dist2(b, hull[j])));
+        }
+        while (along((right + 1) % n) > along(right)) {
+            right = (right + 1) % n;
+        }
+        if (i == 0) {
+            left = j;
+        }
+        while (along((left + 1) % n) < along(left)) {
+            left = (left + 1) % n;
+        }
+
+        double width = height(j);
+        double lo = along(left), hi = along(right);
+        minWidth = min(minWidth, width);
+        if (width * (hi - lo) < bestArea) {
+            bestArea = width * (hi - lo);
+            Point2d normal(-e.y, e.x);
+            Point2d center = Point2d(a.x, a.y) + e * (0.5 * (lo + hi)) + normal * (0.5 * width);
+            float angle = (float)(atan2(e.y, e.x) * 180 / CV_PI);
+            features.minAreaRect = RotatedRect(Point2f((float)(center.x - 0.5), (float)(center.y - 0.5)),
+                Size2f((float)(hi - lo), (float)width), angle);
+        }
+    }
+    features.maxFeret = sqrt(maxFeret2);
+    features.minFeret = minWidth;
+    return features;
+}
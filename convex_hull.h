@@ -0,0 +1,25 @@
+#pragma once
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+// Convex hull in counterclockwise order without collinear points (Andrew's monotone chain)
+vector<Point> monotoneChainHull(vector<Point> points);
+
+// Area of a simple polygon (shoelace formula), positive for counterclockwise order
+double polygonArea(const vector<Point>& polygon);
+
+struct HullFeatures {
+    double convexArea = 0;
+    RotatedRect minAreaRect;
+    double maxFeret = 0;
+    double minFeret = 0;
+};
+
+// Hull based measurements of an object given its traced contour. The hull is taken over the
+// pixel corners, so a single pixel has convex area 1 and Feret diameters sqrt(2) and 1; the
+// rectangle center is in pixel coordinates like the contour. Rotating calipers make the
+// rectangle and both diameters linear in the hull size.
+HullFeatures computeHullFeatures(const vector<Point>& contour);
@@ -0,0 +1,111 @@
+#include "stdafx.h"
+#include "fourier_descriptors.h"
+#include "common.h"
+
+void resampleChainCode(const ChainCode& chainCode, int count, float* points) {
+    const int dx[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+    const int dy[8] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+    const double diagonal = sqrt(2.0);
+
+    double perimeter = 0;
+    for (unsigned int i = 0; i < chainCode.length; i++) {
+        perimeter += (chainCode.directions[i] & 1) ? diagonal : 1.0;
+    }
+
+    // Walk the steps once; sample j sits at arc length j * perimeter / count
+    double x = chainCode.start.x, y = chainCode.start.y;
+    double walked = 0;
+    unsigned int step = 0;
+    for (int j = 0; j < count; j++) {
+        double target = perimeter * j / count;
+        while (step < chainCode.length) {
+            int d = chainCode.directions[step];
+            double length = (d & 1) ? diagonal : 1.0;
+            if (walked + length > target) {
+                break;
+            }
+            walked += length;
+            x += dx[d];
+            y += dy[d];
+            step++;
+        }
+        double fx = 0, fy = 0;
+        if (step < chainCode.length) {
+            int d = chainCode.directions[step];
+            double t = (target - walked) / ((d & 1) ? diagonal : 1.0);
+            fx = t * dx[d];
+            fy = t * dy[d];
+        }
+        points[2 * j] = (float)(x + fx);
+        points[2 * j + 1] = (float)(y + fy);
+    }
+}
+
+void computeFourierDescriptors(const vector<ChainCode>& chainCodes, int harmonics, Mat& descriptors, int samples) {
+    CV_Assert(samples >= 4 && (samples & (samples - 1)) == 0 && harmonics >= 1 && 2 * harmonics + 1 < samples);
+    const int count = (int)chainCodes.size();
+    descriptors.create(count, 2 * harmonics, CV_32F);
+    if (count == 0) {
+        return;
+    }
+
+    // One contour per row as complex x + iy
+    Mat contours(count, samples, CV_32FC2);
+    for (int i = 0; i < count; i++) {
+        resampleChainCode(chainCodes[i], samples, contours.ptr<float>(i));
+    }
+    Mat spectrum;
+    dft(contours, spectrum, DFT_ROWS | DFT_COMPLEX_OUTPUT);
+
+    for (int i = 0; i < count; i++) {
+        const Vec2f* F = spectrum.ptr<Vec2f>(i);
+        float* out = descriptors.ptr<float>(i);
+        auto magnitude = [&](int h) {
+            const Vec2f& c = F[(h + samples) % samples];
+            return sqrt(c[0] * c[0] + c[1] * c[1]);
+        };
+
+        // Mirror the frequencies when the border runs the other way
+        int sign = magnitude(1) >= magnitude(-1) ? 1 : -1;
+        float scale = magnitude(sign);
+        scale = scale > 0 ? 1.0f / scale : 0.0f;
+        for (int h = 1; h <= harmonics; h++) {
+            out[2 * h - 2] = magnitude(sign * (h + 1)) * scale;
+            out[2 * h - 1] = magnitude(-sign * h) * scale;
+        }
+    }
+}
+
+void testFourierDescriptors() {
+    char fname[MAX_PATH];
+    while (openFileDlg(fname)) {
+        Mat_<uchar> src = imread(fname, IMREAD_GRAYSCALE);
+        if (src.empty()) {
+            printf("Could not open or find the image\n");
+            continue;
+        }
+
+        vector<ChainCode> chainCodes;
+        for (const TracedBorder& border : traceAllBorders(src)) {
+            if (!border.isHole) {
+                chainCodes.push_back(border.chainCode);
+            }
+        }
+
+        const int harmonics = 8;
+        Mat descriptors;
+        double t = (double)getTickCount();
+        computeFourierDescriptors(chainCodes, harmonics, descriptors);
+        t = ((double)getTickCount() - t) / getTickFrequency() * 1000;
+
+        for (int i = 0; i < descriptors.rows; i++) {
+            printf("Object at (%d, %d):", chainCodes[i].start.x, chainCodes[i].start.y);
+            for (int k = 0; k < descriptors.cols; k++) {
+                printf(" %.3f", descriptors.at<float>(i, k));
+            }
+            printf("\n");
+        }
+        printf("%d contours in %.2f ms\n", descriptors.rows, t);
+        system("pause");
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <opencv2/core/core.hpp>
+#include <vector>
+#include "border_detection.h"
+
+using namespace cv;
+using namespace std;
+
+// Border points of a closed chain code resampled to count points equally spaced along the
+// border (steps have length 1 or sqrt(2)); written as x, y pairs to points
+void resampleChainCode(const ChainCode& chainCode, int count, float* points);
+
+// Complex Fourier descriptors of many contours, with one DFT_ROWS transform for the whole batch.
+// Each contour is resampled to samples points (a power of two). Row i of descriptors (CV_32F) holds
+// |F(h + 1)| and |F(-h)| for h = 1..harmonics, divided by |F(1)|, so the values do not depend on
+// translation, scale, rotation or the start point. F(1) is taken as the dominant first harmonic,
+// which makes the result independent of the border orientation too.
+void computeFourierDescriptors(const vector<ChainCode>& chainCodes, int harmonics, Mat& descriptors, int samples = 64);
+
+void testFourierDescriptors();
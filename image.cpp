@@ -1,66 +1,192 @@
 #include "stdafx.h"
 #include "image.h"
 #include "common.h"
+#include "labeling.h"
+#include "moments.h"
+#include "border_detection.h"
+#include "convex_hull.h"
+#include <opencv2/core/hal/intrin.hpp>
+#include <future>
+
+static void setHullProperties(ObjectProps& props) {
+    HullFeatures hull = computeHullFeatures(props.contour);
+    props.minAreaRect = hull.minAreaRect;
+    props.convexArea = (float)hull.convexArea;
+    props.solidity = hull.convexArea > 0 ? (float)(props.area / hull.convexArea) : 0.0f;
+    props.maxFeret = (float)hull.maxFeret;
+    props.minFeret = (float)hull.minFeret;
+}
 
 ObjectProps computeObjectProperties(const Mat& labeledImg, int label) {
     ObjectProps props;
+    props.label = label;
     props.area = 0;
     props.contour.clear();
 
-    int sumX = 0, sumY = 0;
-
-    float m11 = 0, m20 = 0, m02 = 0;
+    MomentAccumulator moments;
 
-    vector<Point> objectPixels;
     for (int i = 0; i < labeledImg.rows; i++) {
         for (int j = 0; j < labeledImg.cols; j++) {
             if (labeledImg.at<uchar>(i, j) == label) {
-                objectPixels.push_back(Point(j, i));
-                props.area++;
-                sumX += j;
-                sumY += i;
+                moments.addRun(j, j, i);
             }
         }
     }
 
-    props.center = Point2f(sumX / (float)props.area, sumY / (float)props.area);
-
-    for (const auto& p : objectPixels) {
-        float dx = p.x - props.center.x;
-        float dy = p.y - props.center.y;
-        m11 += dx * dy;
-        m20 += dx * dx;
-        m02 += dy * dy;
+    CentralMoments central = computeCentralMoments(moments);
+    props.area = (int)moments.area;
+    props.boundingBox = moments.boundingBox();
+    props.center = Point2f((float)central.cx, (float)central.cy);
+    momentsToOrientation(central, props.orientation, props.elongation);
+    computeHuMoments(central, props.hu);
+
+    props.perimeter = 0;
+    fill(props.zernike, props.zernike + ZERNIKE_COUNT, 0.0f);
+    if (props.area > 0) {
+        props.contour = traceObjectContour(labeledImg, label, props.boundingBox);
+        props.perimeter = props.contour.size();
+        computeZernikeMoments(labeledImg, label, props.boundingBox, props.zernike);
     }
 
-    m11 /= props.area;
-    m20 /= props.area;
-    m02 /= props.area;
-
-    props.orientation = 0.5 * atan2(2 * m11, m20 - m02) * 180 / CV_PI;
+    props.thinnessFactor = 4 * CV_PI * props.area / (props.perimeter * props.perimeter + 1e-6);
+    setHullProperties(props);
 
-    double lambda1 = 0.5 * (m20 + m02 + sqrt(4 * m11 * m11 + (m20 - m02) * (m20 - m02)));
-    double lambda2 = 0.5 * (m20 + m02 - sqrt(4 * m11 * m11 + (m20 - m02) * (m20 - m02)));
-    props.elongation = sqrt(lambda1 / max(lambda2, 1e-6));
+    return props;
+}
 
-    vector<vector<Point>> contours;
-    Mat binary = Mat::zeros(labeledImg.size(), CV_8UC1);
-    for (const auto& p : objectPixels) {
-        binary.at<uchar>(p.y, p.x) = 255;
+vector<Point> traceObjectContour(const Mat& labeledImg, int label, Rect boundingBox) {
+    // The first pixel of the object in raster order lies on the top row of its bounding box
+    Point start(0, 0);
+    if (labeledImg.depth() == CV_8U) {
+        while (start.x < boundingBox.width && labeledImg.at<uchar>(boundingBox.y, boundingBox.x + start.x) != label) {
+            start.x++;
+        }
+    }
+    else {
+        while (start.x < boundingBox.width && labeledImg.at<int>(boundingBox.y, boundingBox.x + start.x) != label) {
+            start.x++;
+        }
     }
-    findContours(binary, contours, RETR_EXTERNAL, CHAIN_APPROX_NONE);
 
-    if (!contours.empty()) {
-        props.contour = contours[0];
-        props.perimeter = props.contour.size();
+    ChainCode chainCode = FastBorderTracer(labeledImg, label, boundingBox).trace(start);
+
+    vector<Point> contour;
+    contour.reserve(max(chainCode.length, 1u));
+    Point current = start;
+    contour.push_back(current + boundingBox.tl());
+    for (size_t i = 0; i + 1 < chainCode.length; i++) {
+        current = getNextPoint(current, chainCode.directions[i]);
+        contour.push_back(current + boundingBox.tl());
     }
-    else {
+    return contour;
+}
+
+vector<ObjectProps> computeAllObjectProperties(const Mat& labeledImg, const Mat& intensityImg) {
+    CV_Assert(labeledImg.type() == CV_8UC1 || labeledImg.type() == CV_32SC1);
+
+    vector<MomentAccumulator> moments = computeLabelMoments(labeledImg, intensityImg);
+
+    vector<ObjectProps> objects(moments.size());
+    for (size_t label = 0; label < moments.size(); label++) {
+        const MomentAccumulator& m = moments[label];
+        ObjectProps& props = objects[label];
+        props.label = (int)label;
+        props.area = (int)m.pixels;
         props.perimeter = 0;
+        props.orientation = 0;
+        props.elongation = 0;
+        props.thinnessFactor = 0;
+        fill(props.hu, props.hu + 7, 0.0);
+        fill(props.zernike, props.zernike + ZERNIKE_COUNT, 0.0f);
+        props.convexArea = props.solidity = props.maxFeret = props.minFeret = 0;
+        if (label == 0 || m.pixels == 0) {
+            continue;
+        }
+
+        CentralMoments central = computeCentralMoments(m);
+        props.center = Point2f((float)central.cx, (float)central.cy);
+        props.boundingBox = m.boundingBox();
+        momentsToOrientation(central, props.orientation, props.elongation);
+        if (central.area > 0) {
+            computeHuMoments(central, props.hu);
+            computeZernikeMoments(labeledImg, (int)label, props.boundingBox, props.zernike);
+        }
+
+        props.contour = traceObjectContour(labeledImg, (int)label, props.boundingBox);
+        props.perimeter = (int)props.contour.size();
+
+        props.thinnessFactor = (float)(4 * CV_PI * props.area / (props.perimeter * props.perimeter + 1e-6));
+        setHullProperties(props);
     }
+    return objects;
+}
 
-    props.thinnessFactor = 4 * CV_PI * props.area / (props.perimeter * props.perimeter + 1e-6);
+ObjectTable computeObjectTable(const Mat& labeledImg) {
+    CV_Assert(labeledImg.type() == CV_8UC1 || labeledImg.type() == CV_32SC1);
 
-    return props;
+    vector<MomentAccumulator> moments = computeLabelMoments(labeledImg);
+    const int count = (int)moments.size();
+
+    ObjectTable table;
+    table.area.assign(count, 0);
+    table.cx.assign(count, 0.0f);
+    table.cy.assign(count, 0.0f);
+    table.orientation.assign(count, 0.0f);
+    table.elongation.assign(count, 0.0f);
+    table.contourOffset.assign(count + 1, 0);
+
+    for (int label = 0; label < count; label++) {
+        const MomentAccumulator& m = moments[label];
+        table.contourOffset[label] = table.contourPoints.size();
+        if (label == 0 || m.pixels == 0) {
+            continue;
+        }
+
+        CentralMoments central = computeCentralMoments(m);
+        table.area[label] = (int)m.pixels;
+        table.cx[label] = (float)central.cx;
+        table.cy[label] = (float)central.cy;
+        momentsToOrientation(central, table.orientation[label], table.elongation[label]);
+
+        vector<Point> contour = traceObjectContour(labeledImg, label, m.boundingBox());
+        table.contourPoints.insert(table.contourPoints.end(), contour.begin(), contour.end());
+    }
+    table.contourOffset[count] = table.contourPoints.size();
+    return table;
+}
+
+void selectObjects(const ObjectTable& table, int minArea, int maxArea, float phiLow, float phiHigh, vector<uchar>& mask) {
+    const int count = table.size();
+    const int* area = table.area.data();
+    const float* orientation = table.orientation.data();
+    mask.resize(count);
+    // Labels that do not occur have area 0, so they never pass with minArea >= 1
+    minArea = max(minArea, 1);
+
+    int i = 0;
+#if CV_SIMD128
+    const v_int32x4 vMinArea = v_setall_s32(minArea), vMaxArea = v_setall_s32(maxArea);
+    const v_float32x4 vLow = v_setall_f32(phiLow), vHigh = v_setall_f32(phiHigh);
+    const v_float32x4 zero = v_setzero_f32(), halfTurn = v_setall_f32(180.0f);
+    for (; i + 16 <= count; i += 16) {
+        v_uint32x4 keep[4];
+        for (int k = 0; k < 4; k++) {
+            v_int32x4 a = v_load(area + i + 4 * k);
+            v_float32x4 phi = v_load(orientation + i + 4 * k);
+            phi = phi + (halfTurn & (phi < zero));
+            v_int32x4 areaOk = (a >= vMinArea) & (a < vMaxArea);
+            v_float32x4 phiOk = (phi >= vLow) & (phi <= vHigh);
+            keep[k] = v_reinterpret_as_u32(areaOk) & v_reinterpret_as_u32(phiOk);
+        }
+        v_store(mask.data() + i, v_pack_b(keep[0], keep[1], keep[2], keep[3]));
+    }
+#endif
+    for (; i < count; i++) {
+        float phi = orientation[i];
+        if (phi < 0) phi += 180;
+        bool keep = area[i] >= minArea && area[i] < maxArea && phi >= phiLow && phi <= phiHigh;
+        mask[i] = keep ? 255 : 0;
+    }
 }
 
 void computeProjections(const Mat& labeledImg, int label, Mat& horizontalProjection, Mat& verticalProjection) {
@@ -80,6 +206,83 @@ void computeProjections(const Mat& labeledImg, int label, Mat& horizontalProject
     }
 }
 
+template <typename LabelType>
+static void accumulateProjections(const Mat& labeledImg, ProjectionTable& table) {
+    const int labelCount = (int)table.boundingBox.size();
+    int* values = table.values.data();
+    for (int i = 0; i < labeledImg.rows; i++) {
+        const LabelType* row = labeledImg.ptr<LabelType>(i);
+        int j = 0;
+        while (j < labeledImg.cols) {
+            int label = (int)row[j];
+            int start = j;
+            while (j < labeledImg.cols && row[j] == (LabelType)label) {
+                j++;
+            }
+            if (label <= 0 || label >= labelCount || table.boundingBox[label].area() == 0) {
+                continue;
+            }
+
+            const Rect& box = table.boundingBox[label];
+            values[table.verticalOffset[label] + (i - box.y)] += j - start;
+            int* horizontal = values + table.horizontalOffset[label] - box.x;
+            for (int k = start; k < j; k++) {
+                horizontal[k]++;
+            }
+        }
+    }
+}
+
+ProjectionTable computeAllProjections(const Mat& labeledImg, const vector<ObjectProps>& objects) {
+    CV_Assert(labeledImg.type() == CV_8UC1 || labeledImg.type() == CV_32SC1);
+
+    // Lay out the arena: horizontal then vertical projection of each label, back to back
+    ProjectionTable table;
+    table.boundingBox.resize(objects.size());
+    table.horizontalOffset.resize(objects.size(), 0);
+    table.verticalOffset.resize(objects.size(), 0);
+    size_t total = 0;
+    for (size_t label = 1; label < objects.size(); label++) {
+        if (objects[label].area == 0) {
+            continue;
+        }
+        const Rect& box = objects[label].boundingBox;
+        table.boundingBox[label] = box;
+        table.horizontalOffset[label] = total;
+        table.verticalOffset[label] = total + box.width;
+        total += box.width + box.height;
+    }
+    table.values.assign(total, 0);
+
+    if (labeledImg.depth() == CV_8U) {
+        accumulateProjections<uchar>(labeledImg, table);
+    }
+    else {
+        accumulateProjections<int>(labeledImg, table);
+    }
+    return table;
+}
+
+struct ObjectFeatureCache {
+    vector<ObjectProps> objects;
+    ProjectionTable projections;
+};
+
+static ObjectFeatureCache computeObjectFeatureCache(Mat labeledImg) {
+    ObjectFeatureCache cache;
+    cache.objects = computeAllObjectProperties(labeledImg);
+    cache.projections = computeAllProjections(labeledImg, cache.objects);
+    return cache;
+}
+
+// Puts back the base image under the overlays drawn by the previous click
+static void restoreRegions(Mat& display, const Mat& base, vector<Rect>& dirty) {
+    for (const Rect& r : dirty) {
+        base(r).copyTo(display(r));
+    }
+    dirty.clear();
+}
+
 void selectObjectAndAnalyze() {
     char fname[MAX_PATH];
     while (openFileDlg(fname)) {
@@ -89,26 +292,36 @@ void selectObjectAndAnalyze() {
             continue;
         }
 
-        Mat displayContourImg = Mat::zeros(labeledImg.size(), CV_8UC3);
-        Mat displayProjectionImg = Mat::zeros(labeledImg.size(), CV_8UC3);
-        cv::cvtColor(labeledImg, displayContourImg, COLOR_GRAY2BGR);
-        cv::cvtColor(labeledImg, displayProjectionImg, COLOR_GRAY2BGR);
+        // Features of all objects are computed once while the user looks at the image
+        shared_future<ObjectFeatureCache> features = async(launch::async, computeObjectFeatureCache, labeledImg).share();
+
+        Mat baseImg;
+        cv::cvtColor(labeledImg, baseImg, COLOR_GRAY2BGR);
+        Mat displayContourImg = baseImg.clone();
+        Mat displayProjectionImg = baseImg.clone();
 
         imshow("Labeled Image - Click on an object", labeledImg);
 
         struct ClickData {
             Mat labeledImg;
+            Mat baseImg;
             Mat displayContourImg;
             Mat displayProjectionImg;
+            shared_future<ObjectFeatureCache> features;
+            vector<Rect> dirtyContour;
+            vector<Rect> dirtyProjection;
             bool clicked;
         };
 
-        ClickData clickData = { labeledImg, displayContourImg, displayProjectionImg, false };
+        ClickData clickData = { labeledImg, baseImg, displayContourImg, displayProjectionImg, features, {}, {}, false };
 
         auto clickCallback = [](int event, int x, int y, int flags, void* userdata) {
             ClickData* data = static_cast<ClickData*>(userdata);
             if (event == EVENT_LBUTTONDOWN) {
                 data->clicked = true;
+                if (x < 0 || y < 0 || x >= data->labeledImg.cols || y >= data->labeledImg.rows) {
+                    return;
+                }
 
                 int label = data->labeledImg.at<uchar>(y, x);
 
@@ -117,7 +330,11 @@ void selectObjectAndAnalyze() {
                     return;
                 }
 
-                ObjectProps props = computeObjectProperties(data->labeledImg, label);
+                if (data->features.wait_for(chrono::seconds(0)) != future_status::ready) {
+                    printf("Object features are still being computed...\n");
+                }
+                const ObjectFeatureCache& cache = data->features.get();
+                const ObjectProps& props = cache.objects[label];
 
                 printf("Object Properties (Label %d):\n", label);
                 printf("Area: %d pixels\n", props.area);
@@ -127,8 +344,9 @@ void selectObjectAndAnalyze() {
                 printf("Thinness Factor: %.4f\n", props.thinnessFactor);
                 printf("Elongation (Aspect Ratio): %.4f\n", props.elongation);
 
-                cv::cvtColor(data->labeledImg, data->displayContourImg, COLOR_GRAY2BGR);
-                cv::cvtColor(data->labeledImg, data->displayProjectionImg, COLOR_GRAY2BGR);
+                Rect image(0, 0, data->labeledImg.cols, data->labeledImg.rows);
+                restoreRegions(data->displayContourImg, data->baseImg, data->dirtyContour);
+                restoreRegions(data->displayProjectionImg, data->baseImg, data->dirtyProjection);
 
                 vector<vector<Point>> contours;
                 contours.push_back(props.contour);
@@ -142,32 +360,37 @@ void selectObjectAndAnalyze() {
                 Point p2(props.center.x + length * cos(radians), props.center.y + length * sin(radians));
                 line(data->displayContourImg, p1, p2, Scalar(255, 0, 0), 2);
 
-                Mat horizontalProj, verticalProj;
-                computeProjections(data->labeledImg, label, horizontalProj, verticalProj);
+                Rect overlay = props.boundingBox | Rect(Point(min(p1.x, p2.x), min(p1.y, p2.y)), Point(max(p1.x, p2.x), max(p1.y, p2.y)) + Point(1, 1));
+                overlay = Rect(overlay.x - 3, overlay.y - 3, overlay.width + 6, overlay.height + 6) & image;
+                data->dirtyContour.push_back(overlay);
 
-                double maxHProj, maxVProj;
-                minMaxLoc(horizontalProj, nullptr, &maxHProj);
-                minMaxLoc(verticalProj, nullptr, &maxVProj);
+                const Rect& box = cache.projections.boundingBox[label];
+                const int* horizontalProj = cache.projections.horizontal(label);
+                const int* verticalProj = cache.projections.vertical(label);
+                int maxHProj = *max_element(horizontalProj, horizontalProj + box.width);
+                int maxVProj = *max_element(verticalProj, verticalProj + box.height);
 
-                for (int j = 0; j < data->labeledImg.cols; j++) {
-                    if (horizontalProj.at<int>(0, j) > 0) {
-                        int height = (horizontalProj.at<int>(0, j) * 100) / (maxHProj + 1);
+                for (int j = 0; j < box.width; j++) {
+                    if (horizontalProj[j] > 0) {
+                        int height = (horizontalProj[j] * 100) / (maxHProj + 1);
                         line(data->displayProjectionImg,
-                            Point(j, data->labeledImg.rows - 1),
-                            Point(j, data->labeledImg.rows - 1 - height),
+                            Point(box.x + j, data->labeledImg.rows - 1),
+                            Point(box.x + j, data->labeledImg.rows - 1 - height),
                             Scalar(0, 255, 0), 1);
                     }
                 }
 
-                for (int i = 0; i < data->labeledImg.rows; i++) {
-                    if (verticalProj.at<int>(i, 0) > 0) {
-                        int width = (verticalProj.at<int>(i, 0) * 100) / (maxVProj + 1);
+                for (int i = 0; i < box.height; i++) {
+                    if (verticalProj[i] > 0) {
+                        int width = (verticalProj[i] * 100) / (maxVProj + 1);
                         line(data->displayProjectionImg,
-                            Point(0, i),
-                            Point(width, i),
+                            Point(0, box.y + i),
+                            Point(width, box.y + i),
                             Scalar(0, 0, 255), 1);
                     }
                 }
+                data->dirtyProjection.push_back(Rect(box.x, data->labeledImg.rows - 101, box.width, 101) & image);
+                data->dirtyProjection.push_back(Rect(0, box.y, 101, box.height) & image);
 
                 imshow("Object Contour and Features", data->displayContourImg);
                 imshow("Object Projections", data->displayProjectionImg);
@@ -178,6 +401,7 @@ void selectObjectAndAnalyze() {
 
         waitKey(0);
         destroyAllWindows();
+        features.wait();
     }
 }
 
@@ -202,45 +426,34 @@ void filterObjectsByAreaAndOrientation() {
         printf("Enter maximum orientation angle (phi_HIGH in degrees): ");
         scanf("%f", &phi_HIGH);
 
-        set<int> uniqueLabels;
-        for (int i = 0; i < labeledImg.rows; i++) {
-            for (int j = 0; j < labeledImg.cols; j++) {
-                int label = labeledImg.at<uchar>(i, j);
-                if (label > 0) {
-                    uniqueLabels.insert(label);
-                }
-            }
-        }
+        ObjectTable objects = computeObjectTable(labeledImg);
+        vector<uchar> mask;
+        selectObjects(objects, 1, TH_area, phi_LOW, phi_HIGH, mask);
 
-        Mat filteredImg = Mat::zeros(labeledImg.size(), CV_8UC1);
-
-        for (int label : uniqueLabels) {
-            ObjectProps props = computeObjectProperties(labeledImg, label);
+        vector<int> keepLut(max(objects.size(), 256), 0);
+        for (int label = 1; label < objects.size(); label++) {
+            if (objects.area[label] == 0) {
+                continue;
+            }
 
-            float phi = props.orientation;
+            float phi = objects.orientation[label];
             if (phi < 0) phi += 180;
 
-            bool meetsAreaCriteria = props.area < TH_area;
-            bool meetsOrientationCriteria = (phi >= phi_LOW && phi <= phi_HIGH);
-
-            if (meetsAreaCriteria && meetsOrientationCriteria) {
-                for (int i = 0; i < labeledImg.rows; i++) {
-                    for (int j = 0; j < labeledImg.cols; j++) {
-                        if (labeledImg.at<uchar>(i, j) == label) {
-                            filteredImg.at<uchar>(i, j) = label;
-                        }
-                    }
-                }
+            if (mask[label]) {
+                keepLut[label] = label;
 
                 printf("Object %d meets criteria (Area: %d, Orientation: %.2f)\n",
-                    label, props.area, phi);
+                    label, objects.area[label], phi);
             }
             else {
                 printf("Object %d doesn't meet criteria (Area: %d, Orientation: %.2f)\n",
-                    label, props.area, phi);
+                    label, objects.area[label], phi);
             }
         }
 
+        Mat filteredImg;
+        applyLabelLut(labeledImg, keepLut, filteredImg);
+
         imshow("Original Labeled Image", labeledImg);
         imshow("Filtered Objects", filteredImg);
 
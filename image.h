@@ -3,6 +3,7 @@
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/highgui/highgui.hpp>
+#include "moments.h"
 #include <set>
 #include <vector>
 
@@ -11,6 +12,8 @@ using namespace std;
 
 // Structure to hold object properties
 struct ObjectProps {
+    int label;
+    Rect boundingBox;
     int area;
     Point2f center;
     float orientation;
@@ -18,12 +21,62 @@ struct ObjectProps {
     float thinnessFactor;
     vector<Point> contour;
     int perimeter;
+    double hu[7];
+    float zernike[ZERNIKE_COUNT];
+    RotatedRect minAreaRect;
+    float convexArea;
+    float solidity;
+    float maxFeret;
+    float minFeret;
 };
 
 ObjectProps computeObjectProperties(const Mat& labeledImg, int label);
 
+// Contour of one object traced with the chain code tracer inside its bounding box only
+vector<Point> traceObjectContour(const Mat& labeledImg, int label, Rect boundingBox);
+
+// Properties of every object in one raster pass; the result is indexed by label (CV_8UC1 or
+// CV_32SC1 label map) and labels that do not occur have area 0. Given a grayscale intensityImg,
+// the center, orientation, elongation and Hu moments are weighted by darkness 255 - I (sub-pixel).
+vector<ObjectProps> computeAllObjectProperties(const Mat& labeledImg, const Mat& intensityImg = Mat());
+
+// Column-wise object properties (index = label) so that filters only touch the columns they
+// test. The contour of label i is contourPoints[contourOffset[i] .. contourOffset[i + 1]).
+struct ObjectTable {
+    vector<int> area;
+    vector<float> cx, cy;
+    vector<float> orientation, elongation;
+    vector<Point> contourPoints;
+    vector<size_t> contourOffset;
+
+    int size() const { return (int)area.size(); }
+    const Point* contour(int label) const { return contourPoints.data() + contourOffset[label]; }
+    int contourLength(int label) const { return (int)(contourOffset[label + 1] - contourOffset[label]); }
+};
+
+ObjectTable computeObjectTable(const Mat& labeledImg);
+
+// mask[label] = 255 for objects with minArea <= area < maxArea whose orientation, taken in
+// [0, 180), lies in [phiLow, phiHigh]; 0 otherwise (including labels that do not occur)
+void selectObjects(const ObjectTable& table, int minArea, int maxArea, float phiLow, float phiHigh, vector<uchar>& mask);
+
 void computeProjections(const Mat& labeledImg, int label, Mat& horizontalProjection, Mat& verticalProjection);
 
+// Projections of every object over its bounding box, kept in one flat array. For a label, the
+// horizontal projection has boundingBox.width entries and the vertical one boundingBox.height.
+struct ProjectionTable {
+    vector<int> values;
+    vector<size_t> horizontalOffset;
+    vector<size_t> verticalOffset;
+    vector<Rect> boundingBox;
+
+    const int* horizontal(int label) const { return values.data() + horizontalOffset[label]; }
+    const int* vertical(int label) const { return values.data() + verticalOffset[label]; }
+};
+
+// Fills the projections of all objects in a single scan, using the boxes from computeAllObjectProperties
+ProjectionTable computeAllProjections(const Mat& labeledImg, const vector<ObjectProps>& objects);
+
 void selectObjectAndAnalyze();
 
 void filterObjectsByAreaAndOrientation();
\ No newline at end of file
@@ -1,29 +1,146 @@
 #include "labeling.h"
 #include "stdafx.h"
 #include "common.h"
+#include <opencv2/core/hal/intrin.hpp>
+#include <algorithm>
 
 using namespace std;
 using namespace cv;
 
-Mat_<Vec3b> labelImageColoring(const Mat_<uchar>& labeledImg) {
-	Mat_<Vec3b> coloredImg = Mat_<Vec3b>::zeros(labeledImg.size());
-	const uint MAX_LABEL = 255;
-	Vec3b colors[MAX_LABEL] = { 0 };
-	for (int i = 0; i < MAX_LABEL; i++) {
-		colors[i] = Vec3b(rand() % 256, rand() % 256, rand() % 256);
-	}
+LabelPalette::LabelPalette(int labelCount) {
+    reserve(labelCount);
+}
 
-	const Vec3b backgroundColor = Vec3b(rand() % 256, rand() % 256, rand() % 256);
-	for (int i = 0; i < labeledImg.rows; i++) {
-		for (int j = 0; j < labeledImg.cols; j++) {
-			if (labeledImg(i, j) > 0 && labeledImg(i, j) < MAX_LABEL) {
-				coloredImg(i, j) = colors[labeledImg(i, j)];
-			}
-			else {
-				coloredImg(i, j) = backgroundColor;
-			}
-		}
-	}
+int LabelPalette::packedColor(int label) {
+    if (label == 0) {
+        return 0;
+    }
+    // Integer hash, channels kept above 64 so objects stand out from the black background
+    unsigned int h = (unsigned int)label;
+    h ^= h >> 16;
+    h *= 0x7feb352dU;
+    h ^= h >> 15;
+    h *= 0x846ca68bU;
+    h ^= h >> 16;
+    return (int)((h & 0xBFBFBF) | 0x404040);
+}
+
+void LabelPalette::reserve(int labelCount) {
+    int oldSize = (int)lut.size();
+    if (labelCount <= oldSize) {
+        return;
+    }
+    lut.resize(labelCount);
+    for (int i = oldSize; i < labelCount; i++) {
+        lut[i] = packedColor(i);
+    }
+}
+
+Vec3b LabelPalette::color(int label) const {
+    int c = (label >= 0 && label < (int)lut.size()) ? lut[label] : packedColor(label);
+    return Vec3b(c & 0xFF, (c >> 8) & 0xFF, (c >> 16) & 0xFF);
+}
+
+void LabelPalette::render(const Mat& labels, Mat& dst) const {
+    CV_Assert(labels.type() == CV_32SC1 || labels.type() == CV_8UC1);
+    CV_Assert(lut.size() >= 256);
+    dst.create(labels.size(), CV_8UC3);
+
+    const int* table = lut.data();
+    const int tableSize = (int)lut.size();
+    for (int i = 0; i < labels.rows; i++) {
+        uchar* out = dst.ptr<uchar>(i);
+        int j = 0;
+
+        if (labels.depth() == CV_8U) {
+            const uchar* row = labels.ptr<uchar>(i);
+            for (; j < labels.cols; j++) {
+                int c = table[row[j]];
+                out[3 * j] = (uchar)c;
+                out[3 * j + 1] = (uchar)(c >> 8);
+                out[3 * j + 2] = (uchar)(c >> 16);
+            }
+            continue;
+        }
+
+        const int* row = labels.ptr<int>(i);
+#if CV_SIMD128
+        // Gather 4 packed BGR0 colors, drop every 4th byte and store 12 bytes; the 4 extra
+        // bytes written are overwritten by the next block, hence the j + 6 bound
+        const v_uint32x4 limit = v_setall_u32((unsigned int)tableSize);
+        for (; j + 6 <= labels.cols; j += 4) {
+            v_int32x4 idx = v_load(row + j);
+            if (!v_check_all(v_reinterpret_as_u32(idx) < limit)) {
+                break;
+            }
+            v_uint8x16 colors = v_reinterpret_as_u8(v_lut(table, idx));
+            v_store(out + 3 * j, v_pack_triplets(colors));
+        }
+#endif
+        for (; j < labels.cols; j++) {
+            int label = row[j];
+            int c = (unsigned int)label < (unsigned int)tableSize ? table[label] : packedColor(label);
+            out[3 * j] = (uchar)c;
+            out[3 * j + 1] = (uchar)(c >> 8);
+            out[3 * j + 2] = (uchar)(c >> 16);
+        }
+    }
+}
+
+void applyLabelLut(const Mat& labels, const vector<int>& lut, Mat& dst) {
+    CV_Assert(labels.type() == CV_32SC1 || labels.type() == CV_8UC1);
+    CV_Assert(lut.size() >= 256);
+
+    if (labels.depth() == CV_8U) {
+        // 8-bit maps go through cv::LUT when the new labels still fit in a byte
+        bool fits = true;
+        Mat_<uchar> table(1, 256);
+        for (int k = 0; k < 256; k++) {
+            fits = fits && lut[k] >= 0 && lut[k] < 256;
+            table(0, k) = (uchar)lut[k];
+        }
+        if (fits) {
+            LUT(labels, table, dst);
+            return;
+        }
+    }
+
+    Mat result(labels.size(), CV_32SC1);
+    const int* table = lut.data();
+    const int tableSize = (int)lut.size();
+    for (int i = 0; i < labels.rows; i++) {
+        int* out = result.ptr<int>(i);
+        int j = 0;
+        if (labels.depth() == CV_8U) {
+            const uchar* row = labels.ptr<uchar>(i);
+            for (; j < labels.cols; j++) {
+                out[j] = table[row[j]];
+            }
+            continue;
+        }
+
+        const int* row = labels.ptr<int>(i);
+#if CV_SIMD128
+        const v_uint32x4 limit = v_setall_u32((unsigned int)tableSize);
+        for (; j + 4 <= labels.cols; j += 4) {
+            v_int32x4 idx = v_load(row + j);
+            if (!v_check_all(v_reinterpret_as_u32(idx) < limit)) {
+                break;
+            }
+            v_store(out + j, v_lut(table, idx));
+        }
+#endif
+        for (; j < labels.cols; j++) {
+            out[j] = (unsigned int)row[j] < (unsigned int)tableSize ? table[row[j]] : 0;
+        }
+    }
+    dst = result;
+}
+
+Mat_<Vec3b> labelImageColoring(const Mat_<uchar>& labeledImg) {
+	static const LabelPalette palette;
+	Mat_<Vec3b> coloredImg;
+	palette.render(labeledImg, coloredImg);
 
 	imshow("Colored Image", coloredImg);
 	waitKey(0);
@@ -159,4 +276,398 @@ Mat_<uchar> labelImageTwoPass() {
 	imshow("Initial image", image);
 	imshow("Labeled image", labelImageColoring(labeledImg));
 	return labeledImg;
+}
+
+StreamingLabeler::StreamingLabeler(int width, function<void(const ComponentStats&)> onComponent)
+    : width(width), previousRow(width, -1), currentRow(width, -1), onComponent(onComponent) {
+}
+
+int StreamingLabeler::unite(int a, int b) {
+    a = equivalences.find(a);
+    b = equivalences.find(b);
+    if (a == b) {
+        return a;
+    }
+    int root = equivalences.uniteRoots(a, b);
+    stats[root].merge(stats[root == a ? b : a]);
+    return root;
+}
+
+void StreamingLabeler::pushRow(const uchar* row) {
+    const int y = rowIndex;
+    for (int x = 0; x < width; x++) {
+        if (row[x] != 0) {
+            currentRow[x] = -1;
+            continue;
+        }
+
+        // N touches W, NW and NE, so only W/NW and NE can still be disjoint
+        int label;
+        int north = previousRow[x];
+        if (north >= 0) {
+            label = equivalences.find(north);
+        }
+        else {
+            int west = x > 0 ? currentRow[x - 1] : -1;
+            if (west < 0 && x > 0) {
+                west = previousRow[x - 1];
+            }
+            int northEast = x + 1 < width ? previousRow[x + 1] : -1;
+            if (west >= 0 && northEast >= 0) {
+                label = unite(west, northEast);
+            }
+            else if (west >= 0 || northEast >= 0) {
+                label = equivalences.find(west >= 0 ? west : northEast);
+            }
+            else {
+                label = equivalences.makeLabel();
+                stats.push_back(ComponentStats());
+            }
+        }
+
+        currentRow[x] = label;
+        stats[label].addPixel(x, y);
+    }
+    closeRow();
+}
+
+void StreamingLabeler::pushBand(const Mat_<uchar>& band) {
+    CV_Assert(band.cols == width);
+    for (int i = 0; i < band.rows; i++) {
+        pushRow(band[i]);
+    }
+}
+
+void StreamingLabeler::closeRow() {
+    // Compact the labels still present in this row to 0..open-1; every other root is finished
+    const int count = equivalences.size();
+    remap.assign(count, -1);
+    openStats.clear();
+    for (int x = 0; x < width; x++) {
+        if (currentRow[x] < 0) {
+            continue;
+        }
+        int root = equivalences.find(currentRow[x]);
+        if (remap[root] < 0) {
+            remap[root] = (int)openStats.size();
+            openStats.push_back(stats[root]);
+        }
+        currentRow[x] = remap[root];
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (equivalences.parent[i] == i && remap[i] < 0) {
+            stats[i].label = ++nextComponent;
+            onComponent(stats[i]);
+        }
+    }
+
+    equivalences.reset((int)openStats.size());
+    stats.swap(openStats);
+    previousRow.swap(currentRow);
+    rowIndex++;
+}
+
+void StreamingLabeler::finish() {
+    for (int i = 0; i < (int)stats.size(); i++) {
+        stats[i].label = ++nextComponent;
+        onComponent(stats[i]);
+    }
+    stats.clear();
+    equivalences.reset(0);
+    fill(previousRow.begin(), previousRow.end(), -1);
+}
+
+void testStreamingLabeling() {
+    char fname[MAX_PATH];
+    while (openFileDlg(fname)) {
+        Mat_<uchar> image = imread(fname, IMREAD_GRAYSCALE);
+        if (image.empty()) {
+            printf("Could not open or find the image\n");
+            continue;
+        }
+
+        Mat_<Vec3b> display;
+        cvtColor(image, display, COLOR_GRAY2BGR);
+
+        StreamingLabeler labeler(image.cols, [&display](const ComponentStats& c) {
+            printf("Component %d: area %lld, center (%.2f, %.2f), box %dx%d at (%d, %d)\n",
+                c.label, c.area, c.center().x, c.center().y,
+                c.maxX - c.minX + 1, c.maxY - c.minY + 1, c.minX, c.minY);
+            rectangle(display, c.boundingBox(), Scalar(0, 0, 255), 1);
+            });
+
+        // Feed the image one row at a time, as a line-scan camera would
+        double t = (double)getTickCount();
+        for (int i = 0; i < image.rows; i++) {
+            labeler.pushRow(image[i]);
+        }
+        labeler.finish();
+        t = ((double)getTickCount() - t) / getTickFrequency();
+        printf("Time = %.3f [ms]\n", t * 1000);
+
+        imshow("Initial image", image);
+        imshow("Streamed components", display);
+        waitKey(0);
+        destroyAllWindows();
+    }
+}
+
+VolumeLabeler::VolumeLabeler(Size sliceSize, int connectivity, function<void(const VolumeComponentStats&)> onComponent)
+    : sliceSize(sliceSize), connectivity(connectivity), onComponent(onComponent) {
+    CV_Assert(connectivity == 6 || connectivity == 18 || connectivity == 26);
+    previousSlice = Mat_<int>(sliceSize, -1);
+    currentSlice = Mat_<int>(sliceSize, -1);
+}
+
+int VolumeLabeler::unite(int a, int b) {
+    a = equivalences.find(a);
+    b = equivalences.find(b);
+    if (a == b) {
+        return a;
+    }
+    int root = equivalences.uniteRoots(a, b);
+    stats[root].merge(stats[root == a ? b : a]);
+    return root;
+}
+
+void VolumeLabeler::pushSlice(const Mat_<uchar>& slice) {
+    CV_Assert(slice.size() == sliceSize);
+
+    // Already visited neighbors: (dx, dy) in the current slice, then (dx, dy) in the previous one
+    static const int inSlice8[4][2] = { { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 } };
+    static const int below26[9][2] = { { 0, 0 }, { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 },
+        { -1, -1 }, { 1, -1 }, { -1, 1 }, { 1, 1 } };
+    const int inSliceCount = connectivity == 6 ? 1 : 4;
+    const int belowCount = connectivity == 6 ? 1 : (connectivity == 18 ? 5 : 9);
+    const int z = sliceIndex;
+
+    for (int y = 0; y < sliceSize.height; y++) {
+        const uchar* row = slice[y];
+        int* out = currentSlice[y];
+        for (int x = 0; x < sliceSize.width; x++) {
+            if (row[x] != 0) {
+                out[x] = -1;
+                continue;
+            }
+
+            int label = -1;
+            auto join = [&](int neighbor) {
+                if (neighbor >= 0) {
+                    label = label < 0 ? equivalences.find(neighbor) : unite(label, neighbor);
+                }
+            };
+
+            // 6-connectivity only keeps W (and N below), the face neighbors
+            for (int k = 0; k < inSliceCount; k++) {
+                int dx = inSlice8[k][0], dy = inSlice8[k][1];
+                int nx = x + dx, ny = y + dy;
+                if (nx >= 0 && ny >= 0 && nx < sliceSize.width) {
+                    join(currentSlice(ny, nx));
+                }
+            }
+            if (connectivity == 6 && y > 0) {
+                join(currentSlice(y - 1, x));
+            }
+            if (z > 0) {
+                for (int k = 0; k < belowCount; k++) {
+                    int nx = x + below26[k][0], ny = y + below26[k][1];
+                    if (nx >= 0 && ny >= 0 && nx < sliceSize.width && ny < sliceSize.height) {
+                        join(previousSlice(ny, nx));
+                    }
+                }
+            }
+
+            if (label < 0) {
+                label = equivalences.makeLabel();
+                stats.push_back(VolumeComponentStats());
+            }
+            out[x] = label;
+            stats[label].addVoxel(x, y, z);
+        }
+    }
+    closeSlice();
+}
+
+void VolumeLabeler::closeSlice() {
+    const int count = equivalences.size();
+    remap.assign(count, -1);
+    openStats.clear();
+    for (int y = 0; y < sliceSize.height; y++) {
+        int* labels = currentSlice[y];
+        for (int x = 0; x < sliceSize.width; x++) {
+            if (labels[x] < 0) {
+                continue;
+            }
+            int root = equivalences.find(labels[x]);
+            if (remap[root] < 0) {
+                remap[root] = (int)openStats.size();
+                openStats.push_back(stats[root]);
+            }
+            labels[x] = remap[root];
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (equivalences.parent[i] == i && remap[i] < 0) {
+            stats[i].label = ++nextComponent;
+            onComponent(stats[i]);
+        }
+    }
+
+    equivalences.reset((int)openStats.size());
+    stats.swap(openStats);
+    swap(previousSlice, currentSlice);
+    sliceIndex++;
+}
+
+void VolumeLabeler::finish() {
+    for (int i = 0; i < (int)stats.size(); i++) {
+        stats[i].label = ++nextComponent;
+        onComponent(stats[i]);
+    }
+    stats.clear();
+    equivalences.reset(0);
+    previousSlice.setTo(-1);
+}
+
+vector<VolumeComponentStats> labelVolume(const vector<Mat>& slices, int connectivity) {
+    vector<VolumeComponentStats> components;
+    if (slices.empty()) {
+        return components;
+    }
+    VolumeLabeler labeler(slices[0].size(), connectivity, [&components](const VolumeComponentStats& c) {
+        components.push_back(c);
+        });
+    for (const Mat& slice : slices) {
+        labeler.pushSlice(slice);
+    }
+    labeler.finish();
+    return components;
+}
+
+vector<VolumeComponentStats> labelVolume(const Mat& volume, int connectivity) {
+    CV_Assert(volume.dims == 3 && volume.type() == CV_8UC1);
+    vector<VolumeComponentStats> components;
+    Size sliceSize(volume.size[2], volume.size[1]);
+    VolumeLabeler labeler(sliceSize, connectivity, [&components](const VolumeComponentStats& c) {
+        components.push_back(c);
+        });
+    for (int z = 0; z < volume.size[0]; z++) {
+        Mat_<uchar> slice(sliceSize.height, sliceSize.width, const_cast<uchar*>(volume.ptr<uchar>(z)), volume.step[1]);
+        labeler.pushSlice(slice);
+    }
+    labeler.finish();
+    return components;
+}
+
+void testVolumeLabeling() {
+    char folderName[MAX_PATH];
+    if (openFolderDlg(folderName) == 0) {
+        return;
+    }
+
+    int connectivity;
+    printf("Enter connectivity (6, 18 or 26): ");
+    scanf("%d", &connectivity);
+    if (connectivity != 6 && connectivity != 18 && connectivity != 26) {
+        printf("Invalid connectivity\n");
+        return;
+    }
+
+    // Slices are the folder's BMP files in name order, streamed one at a time. The directory
+    // enumeration order depends on the filesystem, so the names are sorted first.
+    char fname[MAX_PATH];
+    FileGetter fg(folderName, "bmp");
+    vector<string> sliceNames;
+    while (fg.getNextAbsFile(fname)) {
+        sliceNames.push_back(fname);
+    }
+    sort(sliceNames.begin(), sliceNames.end());
+
+    int components = 0;
+    unique_ptr<VolumeLabeler> labeler;
+    Size sliceSize;
+    double t = (double)getTickCount();
+    for (const string& name : sliceNames) {
+        Mat_<uchar> slice = imread(name, IMREAD_GRAYSCALE);
+        if (slice.empty()) {
+            continue;
+        }
+        if (!labeler) {
+            sliceSize = slice.size();
+            labeler.reset(new VolumeLabeler(sliceSize, connectivity, [&components](const VolumeComponentStats& c) {
+                components++;
+                printf("Component %d: %lld voxels, box (%d, %d, %d) - (%d, %d, %d)\n",
+                    c.label, c.volume, c.minX, c.minY, c.minZ, c.maxX, c.maxY, c.maxZ);
+                }));
+        }
+        if (slice.size() != sliceSize) {
+            printf("Skipping %s: slice size differs\n", name.c_str());
+            continue;
+        }
+        labeler->pushSlice(slice);
+    }
+    if (!labeler) {
+        printf("No slices found\n");
+        return;
+    }
+    labeler->finish();
+    t = ((double)getTickCount() - t) / getTickFrequency();
+    printf("%d components, time = %.3f [ms]\n", components, t * 1000);
+    system("pause");
+}
+
+int labelBinaryImage(const Mat_<uchar>& image, Mat_<int>& labels, vector<ComponentStats>* stats, int connectivity) {
+    return labelComponents(image, labels, BinaryForeground(), stats, connectivity);
+}
+
+void testFlatZoneLabeling() {
+    char fname[MAX_PATH];
+    while (openFileDlg(fname)) {
+        Mat src = imread(fname, IMREAD_UNCHANGED);
+        if (src.empty()) {
+            printf("Could not open or find the image\n");
+            continue;
+        }
+
+        int tolerance;
+        printf("Enter intensity tolerance (0 = flat zones): ");
+        scanf("%d", &tolerance);
+
+        Mat_<int> labels;
+        int count;
+        double t = (double)getTickCount();
+        if (src.type() == CV_8UC3) {
+            if (tolerance == 0) {
+                count = labelComponents(Mat_<Vec3b>(src), labels, FlatZone<Vec3b>());
+            }
+            else {
+                count = labelComponents(Mat_<Vec3b>(src), labels, ColorTolerance(tolerance));
+            }
+        }
+        else {
+            Mat gray = src;
+            if (src.channels() != 1) {
+                cvtColor(src, gray, COLOR_BGRA2GRAY);
+            }
+            if (tolerance == 0) {
+                count = labelComponents(Mat_<uchar>(gray), labels, FlatZone<uchar>());
+            }
+            else {
+                count = labelComponents(Mat_<uchar>(gray), labels, IntensityTolerance(tolerance));
+            }
+        }
+        t = ((double)getTickCount() - t) / getTickFrequency();
+        printf("%d regions, time = %.3f [ms]\n", count, t * 1000);
+
+        LabelPalette palette(count + 1);
+        Mat colored;
+        palette.render(labels, colored);
+
+        imshow("Initial image", src);
+        imshow("Regions", colored);
+        waitKey(0);
+        destroyAllWindows();
+    }
 }
\ No newline at end of file
@@ -3,14 +3,374 @@
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/highgui/highgui.hpp>
+#include <climits>
+#include <functional>
+#include <memory>
 #include <set>
 #include <vector>
 
 using namespace cv;
 using namespace std;
 
+// Deterministic label -> color table; a label gets the same color on every call and frame
+class LabelPalette {
+public:
+    explicit LabelPalette(int labelCount = 256);
+
+    void reserve(int labelCount);
+    Vec3b color(int label) const;
+
+    // labels is CV_32SC1 or CV_8UC1; dst is reused when it already is a CV_8UC3 of the same size
+    void render(const Mat& labels, Mat& dst) const;
+
+private:
+    static int packedColor(int label);
+
+    vector<int> lut;
+};
+
 Mat_<uchar> labelImageLateralTraversal();
 
 Mat_<Vec3b> labelImageColoring(const Mat_<uchar>& labeledImg);
 
-Mat_<uchar> labelImageTwoPass();
\ No newline at end of file
+Mat_<uchar> labelImageTwoPass();
+
+// Union-find over provisional labels, shared by the labeling engines
+struct LabelEquivalences {
+    vector<int> parent;
+
+    int makeLabel() {
+        parent.push_back((int)parent.size());
+        return (int)parent.size() - 1;
+    }
+
+    int find(int x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+
+    // Links two roots, the smaller label becomes the representative
+    int uniteRoots(int a, int b) {
+        if (b < a) {
+            swap(a, b);
+        }
+        parent[b] = a;
+        return a;
+    }
+
+    void reset(int count) {
+        parent.resize(count);
+        for (int i = 0; i < count; i++) {
+            parent[i] = i;
+        }
+    }
+
+    int size() const {
+        return (int)parent.size();
+    }
+};
+
+// Features accumulated for a connected component while it is being labeled
+struct ComponentStats {
+    int label = 0;
+    long long area = 0;
+    long long sumX = 0, sumY = 0;
+    int minX = INT_MAX, minY = INT_MAX;
+    int maxX = INT_MIN, maxY = INT_MIN;
+    Point start = Point(-1, -1);
+
+    void addPixel(int x, int y) {
+        if (area == 0) {
+            start = Point(x, y);
+        }
+        area++;
+        sumX += x;
+        sumY += y;
+        minX = min(minX, x);
+        maxX = max(maxX, x);
+        minY = min(minY, y);
+        maxY = max(maxY, y);
+    }
+
+    void merge(const ComponentStats& other) {
+        if (other.area == 0) {
+            return;
+        }
+        if (area == 0 || other.start.y < start.y || (other.start.y == start.y && other.start.x < start.x)) {
+            start = other.start;
+        }
+        area += other.area;
+        sumX += other.sumX;
+        sumY += other.sumY;
+        minX = min(minX, other.minX);
+        maxX = max(maxX, other.maxX);
+        minY = min(minY, other.minY);
+        maxY = max(maxY, other.maxY);
+    }
+
+    Rect boundingBox() const {
+        return Rect(minX, minY, maxX - minX + 1, maxY - minY + 1);
+    }
+
+    Point2d center() const {
+        return Point2d(sumX / (double)area, sumY / (double)area);
+    }
+};
+
+// Labels an image delivered row by row (8-connectivity, object pixels are 0).
+// Only the previous row and the still open components are kept in memory; a
+// component is reported through onComponent as soon as it can no longer grow.
+class StreamingLabeler {
+public:
+    StreamingLabeler(int width, function<void(const ComponentStats&)> onComponent);
+
+    void pushRow(const uchar* row);
+    void pushBand(const Mat_<uchar>& band);
+    void finish();
+
+    int rowsProcessed() const { return rowIndex; }
+    int openComponents() const { return equivalences.size(); }
+
+private:
+    int unite(int a, int b);
+    void closeRow();
+
+    int width;
+    int rowIndex = 0;
+    int nextComponent = 0;
+    vector<int> previousRow;
+    vector<int> currentRow;
+    vector<int> remap;
+    LabelEquivalences equivalences;
+    vector<ComponentStats> stats;
+    vector<ComponentStats> openStats;
+    function<void(const ComponentStats&)> onComponent;
+};
+
+void testStreamingLabeling();
+
+// Voxel count and bounding box of a 3D component
+struct VolumeComponentStats {
+    int label = 0;
+    long long volume = 0;
+    int minX = INT_MAX, minY = INT_MAX, minZ = INT_MAX;
+    int maxX = INT_MIN, maxY = INT_MIN, maxZ = INT_MIN;
+
+    void addVoxel(int x, int y, int z) {
+        volume++;
+        minX = min(minX, x);
+        maxX = max(maxX, x);
+        minY = min(minY, y);
+        maxY = max(maxY, y);
+        minZ = min(minZ, z);
+        maxZ = max(maxZ, z);
+    }
+
+    void merge(const VolumeComponentStats& other) {
+        volume += other.volume;
+        minX = min(minX, other.minX);
+        maxX = max(maxX, other.maxX);
+        minY = min(minY, other.minY);
+        maxY = max(maxY, other.maxY);
+        minZ = min(minZ, other.minZ);
+        maxZ = max(maxZ, other.maxZ);
+    }
+};
+
+// 6/18/26-connected labeling of a z-stack delivered slice by slice (object voxels are 0).
+// Only the previous slice's labels and the open components are kept; a component is
+// reported as soon as the current slice no longer touches it.
+class VolumeLabeler {
+public:
+    VolumeLabeler(Size sliceSize, int connectivity, function<void(const VolumeComponentStats&)> onComponent);
+
+    void pushSlice(const Mat_<uchar>& slice);
+    void finish();
+
+private:
+    int unite(int a, int b);
+    void closeSlice();
+
+    Size sliceSize;
+    int connectivity;
+    int sliceIndex = 0;
+    int nextComponent = 0;
+    Mat_<int> previousSlice;
+    Mat_<int> currentSlice;
+    vector<int> remap;
+    LabelEquivalences equivalences;
+    vector<VolumeComponentStats> stats;
+    vector<VolumeComponentStats> openStats;
+    function<void(const VolumeComponentStats&)> onComponent;
+};
+
+// Stack given as 2D CV_8UC1 slices or as one 3D CV_8UC1 Mat (planes x rows x cols)
+vector<VolumeComponentStats> labelVolume(const vector<Mat>& slices, int connectivity = 26);
+vector<VolumeComponentStats> labelVolume(const Mat& volume, int connectivity = 26);
+
+void testVolumeLabeling();
+
+// Connectivity predicates for labelComponents. foreground(p) selects the pixels to label and
+// connected(p, q) tells whether two neighboring foreground pixels belong to the same component.
+// transitive marks equivalence relations, for which the labeler may skip redundant neighbors.
+struct BinaryForeground {
+    static const bool transitive = true;
+    bool foreground(uchar p) const { return p == 0; }
+    bool connected(uchar, uchar) const { return true; }
+};
+
+template <typename T>
+struct FlatZone {
+    static const bool transitive = true;
+    bool foreground(const T&) const { return true; }
+    bool connected(const T& p, const T& q) const { return p == q; }
+};
+
+struct IntensityTolerance {
+    static const bool transitive = false;
+    int tolerance;
+    explicit IntensityTolerance(int tolerance) : tolerance(tolerance) {}
+    bool foreground(uchar) const { return true; }
+    bool connected(uchar p, uchar q) const { return abs((int)p - (int)q) <= tolerance; }
+};
+
+struct ColorTolerance {
+    static const bool transitive = false;
+    int tolerance;
+    explicit ColorTolerance(int tolerance) : tolerance(tolerance) {}
+    bool foreground(const Vec3b&) const { return true; }
+    bool connected(const Vec3b& p, const Vec3b& q) const {
+        return abs((int)p[0] - (int)q[0]) <= tolerance &&
+            abs((int)p[1] - (int)q[1]) <= tolerance &&
+            abs((int)p[2] - (int)q[2]) <= tolerance;
+    }
+};
+
+// Two-pass union-find labeling with a compile-time connectivity predicate. Labels are 1..count
+// in raster order of the first pixel, 0 is left for pixels the predicate does not select.
+template <typename T, typename Predicate>
+int labelComponents(const Mat_<T>& image, Mat_<int>& labels, const Predicate& predicate,
+    vector<ComponentStats>* stats = nullptr, int connectivity = 8) {
+    labels.create(image.size());
+    LabelEquivalences equivalences;
+    equivalences.makeLabel();
+
+    auto join = [&](int label, int neighbor) {
+        neighbor = equivalences.find(neighbor);
+        if (label == 0) {
+            return neighbor;
+        }
+        label = equivalences.find(label);
+        return label == neighbor ? label : equivalences.uniteRoots(label, neighbor);
+    };
+
+    for (int i = 0; i < image.rows; i++) {
+        const T* row = image[i];
+        const T* above = i > 0 ? image[i - 1] : nullptr;
+        int* out = labels[i];
+        const int* outAbove = i > 0 ? labels[i - 1] : nullptr;
+
+        for (int j = 0; j < image.cols; j++) {
+            const T& p = row[j];
+            if (!predicate.foreground(p)) {
+                out[j] = 0;
+                continue;
+            }
+
+            int west = (j > 0 && out[j - 1] && predicate.connected(p, row[j - 1])) ? out[j - 1] : 0;
+            int north = (above && outAbove[j] && predicate.connected(p, above[j])) ? outAbove[j] : 0;
+            int northWest = 0, northEast = 0;
+            if (connectivity == 8 && above) {
+                if (j > 0 && outAbove[j - 1] && predicate.connected(p, above[j - 1])) {
+                    northWest = outAbove[j - 1];
+                }
+                if (j + 1 < image.cols && outAbove[j + 1] && predicate.connected(p, above[j + 1])) {
+                    northEast = outAbove[j + 1];
+                }
+            }
+
+            int label = 0;
+            if (Predicate::transitive && connectivity == 8) {
+                // N touches W, NW and NE, so only W/NW and NE can still be disjoint
+                if (north) {
+                    label = north;
+                }
+                else {
+                    label = west ? west : northWest;
+                    if (northEast) {
+                        label = join(label, northEast);
+                    }
+                }
+            }
+            else {
+                if (west) label = join(label, west);
+                if (northWest) label = join(label, northWest);
+                if (north) label = join(label, north);
+                if (northEast) label = join(label, northEast);
+            }
+
+            out[j] = label ? label : equivalences.makeLabel();
+        }
+    }
+
+    // Resolve equivalences into consecutive labels, roots always precede their children
+    vector<int> finalLabel(equivalences.size(), 0);
+    int count = 0;
+    for (int k = 1; k < equivalences.size(); k++) {
+        int root = equivalences.find(k);
+        finalLabel[k] = root == k ? ++count : finalLabel[root];
+    }
+
+    if (stats) {
+        stats->assign(count + 1, ComponentStats());
+        for (int k = 0; k <= count; k++) {
+            (*stats)[k].label = k;
+        }
+    }
+    for (int i = 0; i < labels.rows; i++) {
+        int* out = labels[i];
+        for (int j = 0; j < labels.cols; j++) {
+            out[j] = finalLabel[out[j]];
+            if (stats && out[j]) {
+                (*stats)[out[j]].addPixel(j, i);
+            }
+        }
+    }
+    return count;
+}
+
+int labelBinaryImage(const Mat_<uchar>& image, Mat_<int>& labels, vector<ComponentStats>* stats = nullptr, int connectivity = 8);
+
+void testFlatZoneLabeling();
+
+// Label -> new label table for a per-label feature table (index = label, entry 0 is the
+// background). Rejected labels map to 0; kept ones keep their id or are renumbered 1..kept.
+template <typename Feature, typename Keep>
+vector<int> buildLabelFilter(const vector<Feature>& features, Keep keep, bool renumber, int* keptCount = nullptr) {
+    vector<int> lut(max((size_t)256, features.size()), 0);
+    int kept = 0;
+    for (size_t label = 1; label < features.size(); label++) {
+        if (keep(features[label])) {
+            kept++;
+            lut[label] = renumber ? kept : (int)label;
+        }
+    }
+    if (keptCount) {
+        *keptCount = kept;
+    }
+    return lut;
+}
+
+// One pass dst(p) = lut[labels(p)] for CV_8UC1 or CV_32SC1 label maps, labels past the table map to 0
+void applyLabelLut(const Mat& labels, const vector<int>& lut, Mat& dst);
+
+template <typename Feature, typename Keep>
+int filterComponents(const Mat& labels, const vector<Feature>& features, Keep keep, Mat& dst, bool renumber = false) {
+    int kept;
+    vector<int> lut = buildLabelFilter(features, keep, renumber, &kept);
+    applyLabelLut(labels, lut, dst);
+    return kept;
+}
\ No newline at end of file
@@ -0,0 +1,463 @@
+#include "stdafx.h"
+#include "moments.h"
+#include <opencv2/core/hal/intrin.hpp>
+
+Int128& Int128::operator+=(const Int128& other) {
+    lo += other.lo;
+    hi += other.hi + (lo < other.lo ? 1 : 0);
+    return *this;
+}
+
+Int128& Int128::operator-=(const Int128& other) {
+    unsigned long long borrow = lo < other.lo ? 1 : 0;
+    lo -= other.lo;
+    hi -= other.hi + borrow;
+    return *this;
+}
+
+// Product modulo 2^128, exact as long as the true result fits in 127 bits
+Int128 Int128::operator*(unsigned long long factor) const {
+    const unsigned long long mask = 0xFFFFFFFFULL;
+    unsigned long long a0 = lo & mask, a1 = lo >> 32;
+    unsigned long long b0 = factor & mask, b1 = factor >> 32;
+
+    unsigned long long p00 = a0 * b0;
+    unsigned long long p01 = a0 * b1;
+    unsigned long long p10 = a1 * b0;
+    unsigned long long p11 = a1 * b1;
+    unsigned long long middle = (p00 >> 32) + (p01 & mask) + (p10 & mask);
+
+    Int128 result;
+    result.lo = (p00 & mask) | (middle << 32);
+    result.hi = p11 + (p01 >> 32) + (p10 >> 32) + (middle >> 32) + hi * factor;
+    return result;
+}
+
+double Int128::toDouble() const {
+    if (negative()) {
+        Int128 magnitude;
+        magnitude -= *this;
+        return -magnitude.toDouble();
+    }
+    return ldexp((double)hi, 64) + (double)lo;
+}
+
+static unsigned long long sumOfSquares(long long n) {
+    // 0^2 + 1^2 + ... + n^2
+    if (n <= 0) {
+        return 0;
+    }
+    unsigned long long u = (unsigned long long)n;
+    return u * (u + 1) * (2 * u + 1) / 6;
+}
+
+static unsigned long long sumOfCubes(long long n) {
+    // 0^3 + 1^3 + ... + n^3 = (n(n+1)/2)^2
+    if (n <= 0) {
+        return 0;
+    }
+    unsigned long long u = (unsigned long long)n;
+    unsigned long long half = u * (u + 1) / 2;
+    return half * half;
+}
+
+// Powers t, t^2 and t^3 of the offsets inside a block of weighted pixels
+static const int WEIGHT_BLOCK = 64;
+
+struct OffsetPowers {
+    unsigned int t[3][WEIGHT_BLOCK];
+
+    OffsetPowers() {
+        for (unsigned int k = 0; k < WEIGHT_BLOCK; k++) {
+            t[0][k] = k;
+            t[1][k] = k * k;
+            t[2][k] = k * k * k;
+        }
+    }
+};
+
+static const OffsetPowers offsetPowers;
+
+// Sums of w, w t, w t^2 and w t^3 for t = 0..n-1, n <= WEIGHT_BLOCK. With 8-bit weights and
+// t < 64 every 32-bit lane stays below 2^32.
+static void weightedBlockSums(const uchar* w, int n, unsigned long long s[4]) {
+    unsigned int s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    int k = 0;
+#if CV_SIMD128
+    v_uint32x4 a0 = v_setzero_u32(), a1 = v_setzero_u32(), a2 = v_setzero_u32(), a3 = v_setzero_u32();
+    for (; k + 16 <= n; k += 16) {
+        v_uint16x8 lo, hi;
+        v_expand(v_load(w + k), lo, hi);
+        v_uint32x4 q[4];
+        v_expand(lo, q[0], q[1]);
+        v_expand(hi, q[2], q[3]);
+        for (int i = 0; i < 4; i++) {
+            int offset = k + 4 * i;
+            a0 += q[i];
+            a1 += q[i] * v_load(offsetPowers.t[0] + offset);
+            a2 += q[i] * v_load(offsetPowers.t[1] + offset);
+            a3 += q[i] * v_load(offsetPowers.t[2] + offset);
+        }
+    }
+    s0 = v_reduce_sum(a0);
+    s1 = v_reduce_sum(a1);
+    s2 = v_reduce_sum(a2);
+    s3 = v_reduce_sum(a3);
+#endif
+    for (; k < n; k++) {
+        s0 += w[k];
+        s1 += w[k] * offsetPowers.t[0][k];
+        s2 += w[k] * offsetPowers.t[1][k];
+        s3 += w[k] * offsetPowers.t[2][k];
+    }
+    s[0] = s0;
+    s[1] = s1;
+    s[2] = s2;
+    s[3] = s3;
+}
+
+void MomentAccumulator::addWeightedRun(int x0, int x1, int y, const uchar* weights) {
+    // Each block at base b contributes sum w (b + t)^p, expanded binomially in exact integers
+    unsigned long long w = 0, wx = 0, wxx = 0;
+    Int128 wxxx;
+    for (int b = x0; b <= x1; b += WEIGHT_BLOCK) {
+        unsigned long long s[4];
+        weightedBlockSums(weights + (b - x0), min(WEIGHT_BLOCK, x1 - b + 1), s);
+        unsigned long long ub = (unsigned long long)b;
+        w += s[0];
+        wx += ub * s[0] + s[1];
+        wxx += ub * ub * s[0] + 2 * ub * s[1] + s[2];
+        wxxx += ub * ub * ub * s[0] + 3 * ub * ub * s[1] + 3 * ub * s[2] + s[3];
+    }
+
+    unsigned long long uy = (unsigned long long)y;
+    area += w;
+    pixels += (unsigned long long)(x1 - x0 + 1);
+    sumX += wx;
+    sumY += w * uy;
+    sumXX += wxx;
+    sumXY += Int128(wx) * uy;
+    sumYY += Int128(w) * (uy * uy);
+    sumXXX += wxxx;
+    sumXXY += Int128(wxx) * uy;
+    sumXYY += Int128(wx) * (uy * uy);
+    sumYYY += Int128(w) * (uy * uy * uy);
+
+    minX = min(minX, x0);
+    maxX = max(maxX, x1);
+    minY = min(minY, y);
+    maxY = max(maxY, y);
+}
+
+void MomentAccumulator::addRun(int x0, int x1, int y) {
+    unsigned long long count = (unsigned long long)(x1 - x0 + 1);
+    unsigned long long runX = ((unsigned long long)x0 + (unsigned long long)x1) * count / 2;
+    unsigned long long runXX = sumOfSquares(x1) - sumOfSquares(x0 - 1);
+    unsigned long long runXXX = sumOfCubes(x1) - sumOfCubes(x0 - 1);
+    unsigned long long uy = (unsigned long long)y;
+
+    area += count;
+    pixels += count;
+    sumX += runX;
+    sumY += count * uy;
+    sumXX += runXX;
+    sumXY += runX * uy;
+    sumYY += count * uy * uy;
+    sumXXX += runXXX;
+    sumXXY += runXX * uy;
+    sumXYY += runX * uy * uy;
+    sumYYY += count * uy * uy * uy;
+
+    minX = min(minX, x0);
+    maxX = max(maxX, x1);
+    minY = min(minY, y);
+    maxY = max(maxY, y);
+}
+
+void MomentAccumulator::merge(const MomentAccumulator& other) {
+    area += other.area;
+    pixels += other.pixels;
+    sumX += other.sumX;
+    sumY += other.sumY;
+    sumXX += other.sumXX;
+    sumXY += other.sumXY;
+    sumYY += other.sumYY;
+    sumXXX += other.sumXXX;
+    sumXXY += other.sumXXY;
+    sumXYY += other.sumXYY;
+    sumYYY += other.sumYYY;
+    minX = min(minX, other.minX);
+    maxX = max(maxX, other.maxX);
+    minY = min(minY, other.minY);
+    maxY = max(maxY, other.maxY);
+}
+
+CentralMoments computeCentralMoments(const MomentAccumulator& m) {
+    CentralMoments c;
+    if (m.area == 0) {
+        return c;
+    }
+
+    // Shift the exact sums to an integer point next to the centroid before going to double,
+    // so the subtraction of large nearly equal terms happens in exact arithmetic
+    unsigned long long n = m.area;
+    unsigned long long ox = (unsigned long long)(m.sumX.toDouble() / (double)n);
+    unsigned long long oy = (unsigned long long)(m.sumY.toDouble() / (double)n);
+    Int128 area(n);
+
+    Int128 tx = m.sumX - area * ox;
+    Int128 ty = m.sumY - area * oy;
+    Int128 txx = m.sumXX - m.sumX * (2 * ox) + area * (ox * ox);
+    Int128 tyy = m.sumYY - m.sumY * (2 * oy) + area * (oy * oy);
+    Int128 txy = m.sumXY - m.sumX * oy - m.sumY * ox + area * (ox * oy);
+    Int128 txxx = m.sumXXX - m.sumXX * (3 * ox) + m.sumX * (3 * ox * ox) - area * (ox * ox * ox);
+    Int128 tyyy = m.sumYYY - m.sumYY * (3 * oy) + m.sumY * (3 * oy * oy) - area * (oy * oy * oy);
+    Int128 txxy = m.sumXXY - m.sumXY * (2 * ox) + m.sumY * (ox * ox)
+        - m.sumXX * oy + m.sumX * (2 * ox * oy) - area * (ox * ox * oy);
+    Int128 txyy = m.sumXYY - m.sumXY * (2 * oy) + m.sumX * (oy * oy)
+        - m.sumYY * ox + m.sumY * (2 * ox * oy) - area * (ox * oy * oy);
+
+    double dn = (double)n;
+    double dx = tx.toDouble() / dn;
+    double dy = ty.toDouble() / dn;
+    c.area = dn;
+    c.cx = (double)ox + dx;
+    c.cy = (double)oy + dy;
+    c.mu20 = txx.toDouble() / dn - dx * dx;
+    c.mu02 = tyy.toDouble() / dn - dy * dy;
+    c.mu11 = txy.toDouble() / dn - dx * dy;
+    c.mu30 = txxx.toDouble() / dn - 3 * dx * (txx.toDouble() / dn) + 2 * dx * dx * dx;
+    c.mu03 = tyyy.toDouble() / dn - 3 * dy * (tyy.toDouble() / dn) + 2 * dy * dy * dy;
+    c.mu21 = txxy.toDouble() / dn - 2 * dx * (txy.toDouble() / dn) - dy * (txx.toDouble() / dn) + 2 * dx * dx * dy;
+    c.mu12 = txyy.toDouble() / dn - 2 * dy * (txy.toDouble() / dn) - dx * (tyy.toDouble() / dn) + 2 * dx * dy * dy;
+    return c;
+}
+
+void computeHuMoments(const CentralMoments& c, double hu[7]) {
+    if (c.area <= 0) {
+        fill(hu, hu + 7, 0.0);
+        return;
+    }
+
+    // Scale normalized moments eta_pq = mu_pq / area^((p+q)/2), mu here already divided by the area
+    double s2 = c.area;
+    double s3 = c.area * sqrt(c.area);
+    double n20 = c.mu20 / s2, n02 = c.mu02 / s2, n11 = c.mu11 / s2;
+    double n30 = c.mu30 / s3, n03 = c.mu03 / s3, n21 = c.mu21 / s3, n12 = c.mu12 / s3;
+
+    double a = n30 + n12, b = n21 + n03;
+    double p = n30 - 3 * n12, q = 3 * n21 - n03;
+    hu[0] = n20 + n02;
+    hu[1] = (n20 - n02) * (n20 - n02) + 4 * n11 * n11;
+    hu[2] = p * p + q * q;
+    hu[3] = a * a + b * b;
+    hu[4] = p * a * (a * a - 3 * b * b) + q * b * (3 * a * a - b * b);
+    hu[5] = (n20 - n02) * (a * a - b * b) + 4 * n11 * a * b;
+    hu[6] = q * a * (a * a - 3 * b * b) - p * b * (3 * a * a - b * b);
+}
+
+// Radial polynomial coefficients c_k of R_nm(rho) = sum c_k rho^(n-2k), highest power first
+struct ZernikeBasis {
+    int m[ZERNIKE_COUNT];
+    int terms[ZERNIKE_COUNT];
+    double coeff[ZERNIKE_COUNT][ZERNIKE_ORDER / 2 + 1];
+};
+
+static ZernikeBasis makeZernikeBasis() {
+    ZernikeBasis basis;
+    double factorial[ZERNIKE_ORDER + 1] = { 1 };
+    for (int k = 1; k <= ZERNIKE_ORDER; k++) {
+        factorial[k] = factorial[k - 1] * k;
+    }
+
+    int index = 0;
+    for (int n = 0; n <= ZERNIKE_ORDER; n++) {
+        for (int m = n % 2; m <= n; m += 2, index++) {
+            int terms = (n - m) / 2;
+            basis.m[index] = m;
+            basis.terms[index] = terms;
+            for (int k = 0; k <= terms; k++) {
+                basis.coeff[index][k] = ((k % 2) ? -1.0 : 1.0) * factorial[n - k] /
+                    (factorial[k] * factorial[(n + m) / 2 - k] * factorial[terms - k]);
+            }
+        }
+    }
+    return basis;
+}
+
+// Since rho^m e^(i m theta) = z^m, V_nm = z^m * sum c_k (rho^2)^((n-m)/2-k): the basis is
+// evaluated per pixel from z = x + iy with a Horner loop in rho^2, without pow or atan2
+template <typename LabelType>
+static void accumulateZernike(const Mat& labeledImg, LabelType label, Rect box, const ZernikeBasis& basis,
+    double re[ZERNIKE_COUNT], double im[ZERNIKE_COUNT]) {
+    const double radius = 0.5 * sqrt((double)box.width * box.width + (double)box.height * box.height);
+    for (int i = 0; i < box.height; i++) {
+        const LabelType* row = labeledImg.ptr<LabelType>(box.y + i) + box.x;
+        const double y = (i + 0.5 - 0.5 * box.height) / radius;
+        for (int j = 0; j < box.width; j++) {
+            if (row[j] != label) {
+                continue;
+            }
+            const double x = (j + 0.5 - 0.5 * box.width) / radius;
+            const double rho2 = x * x + y * y;
+
+            double zr[ZERNIKE_ORDER + 1], zi[ZERNIKE_ORDER + 1];
+            zr[0] = 1;
+            zi[0] = 0;
+            for (int m = 1; m <= ZERNIKE_ORDER; m++) {
+                zr[m] = zr[m - 1] * x - zi[m - 1] * y;
+                zi[m] = zr[m - 1] * y + zi[m - 1] * x;
+            }
+
+            for (int k = 0; k < ZERNIKE_COUNT; k++) {
+                double radial = 0;
+                for (int t = 0; t <= basis.terms[k]; t++) {
+                    radial = radial * rho2 + basis.coeff[k][t];
+                }
+                re[k] += radial * zr[basis.m[k]];
+                im[k] += radial * zi[basis.m[k]];
+            }
+        }
+    }
+}
+
+void computeZernikeMoments(const Mat& labeledImg, int label, Rect boundingBox, float magnitudes[ZERNIKE_COUNT]) {
+    CV_Assert(labeledImg.type() == CV_8UC1 || labeledImg.type() == CV_32SC1);
+    static const ZernikeBasis basis = makeZernikeBasis();
+
+    double re[ZERNIKE_COUNT] = { 0 }, im[ZERNIKE_COUNT] = { 0 };
+    if (labeledImg.depth() == CV_8U) {
+        accumulateZernike<uchar>(labeledImg, (uchar)label, boundingBox, basis, re, im);
+    }
+    else {
+        accumulateZernike<int>(labeledImg, label, boundingBox, basis, re, im);
+    }
+
+    // Z_nm = (n + 1) / pi * sum V*_nm dA, with dA the pixel area on the unit disk
+    const double pixelArea = 4.0 / ((double)boundingBox.width * boundingBox.width + (double)boundingBox.height * boundingBox.height);
+    int index = 0;
+    for (int n = 0; n <= ZERNIKE_ORDER; n++) {
+        for (int m = n % 2; m <= n; m += 2, index++) {
+            magnitudes[index] = (float)((n + 1) / CV_PI * pixelArea * sqrt(re[index] * re[index] + im[index] * im[index]));
+        }
+    }
+}
+
+void momentsToOrientation(const CentralMoments& c, float& orientation, float& elongation) {
+    orientation = (float)(0.5 * atan2(2 * c.mu11, c.mu20 - c.mu02) * 180 / CV_PI);
+
+    double root = sqrt(4 * c.mu11 * c.mu11 + (c.mu20 - c.mu02) * (c.mu20 - c.mu02));
+    double lambda1 = 0.5 * (c.mu20 + c.mu02 + root);
+    double lambda2 = 0.5 * (c.mu20 + c.mu02 - root);
+    elongation = (float)sqrt(lambda1 / max(lambda2, 1e-6));
+}
+
+template <typename LabelType>
+static void accumulateRuns(const Mat& labeledImg, const Mat& intensityImg, int rowStart, int rowEnd, vector<MomentAccumulator>& acc) {
+    // Objects are dark, so pixels are weighted by their darkness 255 - I
+    vector<uchar> darkness(intensityImg.empty() ? 0 : labeledImg.cols);
+    for (int i = rowStart; i < rowEnd; i++) {
+        const LabelType* row = labeledImg.ptr<LabelType>(i);
+        const uchar* weights = nullptr;
+        if (!intensityImg.empty()) {
+            const uchar* intensity = intensityImg.ptr<uchar>(i);
+            for (int j = 0; j < labeledImg.cols; j++) {
+                darkness[j] = (uchar)(255 - intensity[j]);
+            }
+            weights = darkness.data();
+        }
+        int j = 0;
+        while (j < labeledImg.cols) {
+            LabelType label = row[j];
+            int start = j;
+            while (j < labeledImg.cols && row[j] == label) {
+                j++;
+            }
+            if (label <= 0) {
+                continue;
+            }
+            if ((size_t)label >= acc.size()) {
+                acc.resize((size_t)label + 1);
+            }
+            if (weights) {
+                acc[(size_t)label].addWeightedRun(start, j - 1, i, weights + start);
+            }
+            else {
+                acc[(size_t)label].addRun(start, j - 1, i);
+            }
+        }
+    }
+}
+
+template <typename LabelType>
+static void accumulateLabelRuns(const Mat& labeledImg, LabelType label, Rect box, MomentAccumulator& m) {
+    for (int i = box.y; i < box.y + box.height; i++) {
+        const LabelType* row = labeledImg.ptr<LabelType>(i);
+        int j = box.x;
+        while (j < box.x + box.width) {
+            if (row[j] != label) {
+                j++;
+                continue;
+            }
+            int start = j;
+            while (j < box.x + box.width && row[j] == label) {
+                j++;
+            }
+            m.addRun(start, j - 1, i);
+        }
+    }
+}
+
+vector<MomentAccumulator> computeLabelMoments(const Mat& labeledImg, const Mat& intensityImg) {
+    CV_Assert(labeledImg.type() == CV_8UC1 || labeledImg.type() == CV_32SC1);
+    CV_Assert(intensityImg.empty() || (intensityImg.type() == CV_8UC1 && intensityImg.size() == labeledImg.size()));
+    CV_Assert(labeledImg.rows <= 65536 && labeledImg.cols <= 65536);
+
+    const bool byteLabels = labeledImg.depth() == CV_8U;
+    const int stripes = max(1, min(labeledImg.rows / 64, getNumThreads() * 4));
+    vector<vector<MomentAccumulator>> partial(stripes);
+
+    parallel_for_(Range(0, stripes), [&](const Range& range) {
+        for (int s = range.start; s < range.end; s++) {
+            int rowStart = (int)((long long)labeledImg.rows * s / stripes);
+            int rowEnd = (int)((long long)labeledImg.rows * (s + 1) / stripes);
+            partial[s].resize(byteLabels ? 256 : 1);
+            if (byteLabels) {
+                accumulateRuns<uchar>(labeledImg, intensityImg, rowStart, rowEnd, partial[s]);
+            }
+            else {
+                accumulateRuns<int>(labeledImg, intensityImg, rowStart, rowEnd, partial[s]);
+            }
+        }
+        });
+
+    // Exact integer merge, so the stripe count never changes the result
+    vector<MomentAccumulator> result;
+    for (const vector<MomentAccumulator>& p : partial) {
+        if (p.size() > result.size()) {
+            result.resize(p.size());
+        }
+        for (size_t label = 0; label < p.size(); label++) {
+            if (p[label].pixels > 0) {
+                result[label].merge(p[label]);
+            }
+        }
+    }
+
+    // Objects with zero total weight (all white) fall back to unweighted moments over their box
+    for (size_t label = 1; label < result.size(); label++) {
+        MomentAccumulator& m = result[label];
+        if (m.pixels == 0 || m.area > 0) {
+            continue;
+        }
+        Rect box = m.boundingBox();
+        m = MomentAccumulator();
+        if (byteLabels) {
+            accumulateLabelRuns<uchar>(labeledImg, (uchar)label, box, m);
+        }
+        else {
+            accumulateLabelRuns<int>(labeledImg, (int)label, box, m);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+#include <climits>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+// Signed 128-bit integer (two's complement), wide enough for exact moment sums of any image
+struct Int128 {
+    unsigned long long lo = 0;
+    unsigned long long hi = 0;
+
+    Int128() {}
+    Int128(unsigned long long value) : lo(value) {}
+
+    Int128& operator+=(const Int128& other);
+    Int128& operator-=(const Int128& other);
+    Int128 operator*(unsigned long long factor) const;
+    bool negative() const { return (hi >> 63) != 0; }
+    double toDouble() const;
+};
+
+inline Int128 operator+(Int128 a, const Int128& b) { return a += b; }
+inline Int128 operator-(Int128 a, const Int128& b) { return a -= b; }
+
+// Raw moments of one object as exact integers. Any split of the image into strips gives the
+// same totals after merge(), so features derived from them are bit-identical across threads.
+// area is the zeroth moment: the pixel count, or the total weight for weighted runs
+struct MomentAccumulator {
+    unsigned long long area = 0;
+    unsigned long long pixels = 0;
+    Int128 sumX, sumY;
+    Int128 sumXX, sumXY, sumYY;
+    Int128 sumXXX, sumXXY, sumXYY, sumYYY;
+    int minX = INT_MAX, minY = INT_MAX;
+    int maxX = INT_MIN, maxY = INT_MIN;
+
+    // Pixels x0..x1 of row y, added with closed forms in 64-bit arithmetic
+    void addRun(int x0, int x1, int y);
+    // Same run with each pixel given its own weight, weights[0] being the weight of x0
+    void addWeightedRun(int x0, int x1, int y, const uchar* weights);
+    void merge(const MomentAccumulator& other);
+
+    Rect boundingBox() const {
+        return Rect(minX, minY, maxX - minX + 1, maxY - minY + 1);
+    }
+};
+
+// Centroid and central moments up to third order, normalized by the area
+struct CentralMoments {
+    double area = 0;
+    double cx = 0, cy = 0;
+    double mu20 = 0, mu11 = 0, mu02 = 0;
+    double mu30 = 0, mu21 = 0, mu12 = 0, mu03 = 0;
+};
+
+CentralMoments computeCentralMoments(const MomentAccumulator& m);
+
+// Orientation in degrees and elongation (sqrt of the inertia eigenvalue ratio)
+void momentsToOrientation(const CentralMoments& c, float& orientation, float& elongation);
+
+// The seven Hu invariants, from the same accumulated moments
+void computeHuMoments(const CentralMoments& c, double hu[7]);
+
+// Zernike moment magnitudes |Z_nm| for n <= ZERNIKE_ORDER, m >= 0 and n - m even, ordered by
+// n then m. The bounding box is mapped onto the unit disk and the basis is evaluated per pixel,
+// so no memory proportional to the box is needed.
+const int ZERNIKE_ORDER = 4;
+const int ZERNIKE_COUNT = 9;
+void computeZernikeMoments(const Mat& labeledImg, int label, Rect boundingBox, float magnitudes[ZERNIKE_COUNT]);
+
+// Per-label accumulators (index = label) for a CV_8UC1 or CV_32SC1 label map of at most
+// 65536 x 65536 pixels. Row strips are accumulated in parallel and merged exactly.
+// With a CV_8UC1 intensityImg of the same size the moments are weighted by darkness (255 - I),
+// since objects are dark; an object whose pixels are all white keeps its unweighted moments.
+vector<MomentAccumulator> computeLabelMoments(const Mat& labeledImg, const Mat& intensityImg = Mat());
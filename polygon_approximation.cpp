@@ -0,0 +1,173 @@
+#include "stdafx.h"
+#include "polygon_approximation.h"
+#include "common.h"
+
+static const int dx[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+static const int dy[8] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+
+struct ChainSpan {
+    unsigned int first, last;
+    Point from, to;
+};
+
+vector<Point> approximateDouglasPeucker(const ChainCode& chainCode, double tolerance) {
+    vector<Point> polygon;
+    polygon.push_back(chainCode.start);
+    const unsigned int n = chainCode.length;
+    if (n < 2) {
+        return polygon;
+    }
+
+    // The point farthest from the start splits the closed border into two open spans
+    unsigned int far = 0;
+    Point farPoint = chainCode.start, p = chainCode.start;
+    long long farDistance = 0;
+    for (unsigned int i = 0; i < n; i++) {
+        p.x += dx[chainCode.directions[i]];
+        p.y += dy[chainCode.directions[i]];
+        long long d = (long long)(p.x - chainCode.start.x) * (p.x - chainCode.start.x) +
+            (long long)(p.y - chainCode.start.y) * (p.y - chainCode.start.y);
+        if (d > farDistance) {
+            farDistance = d;
+            far = i + 1;
+            farPoint = p;
+        }
+    }
+    if (far == 0) {
+        return polygon;
+    }
+
+    // Spans are processed last one first, so vertices come out in border order
+    vector<ChainSpan> stack;
+    stack.push_back({ far, n, farPoint, chainCode.start });
+    stack.push_back({ 0, far, chainCode.start, farPoint });
+    while (!stack.empty()) {
+        ChainSpan span = stack.back();
+        stack.pop_back();
+
+        double ex = span.to.x - span.from.x, ey = span.to.y - span.from.y;
+        double length = sqrt(ex * ex + ey * ey);
+        double best = -1;
+        unsigned int split = span.first;
+        Point splitPoint = span.from;
+        Point q = span.from;
+        for (unsigned int i = span.first; i + 1 < span.last; i++) {
+            q.x += dx[chainCode.directions[i]];
+            q.y += dy[chainCode.directions[i]];
+            double d = length > 0 ? fabs(ex * (q.y - span.from.y) - ey * (q.x - span.from.x)) / length
+                : sqrt((double)(q.x - span.from.x) * (q.x - span.from.x) + (double)(q.y - span.from.y) * (q.y - span.from.y));
+            if (d > best) {
+                best = d;
+                split = i + 1;
+                splitPoint = q;
+            }
+        }
+
+        if (best > tolerance) {
+            stack.push_back({ split, span.last, splitPoint, span.to });
+            stack.push_back({ span.first, split, span.from, splitPoint });
+        }
+        else if (span.last < n) {
+            polygon.push_back(span.to);
+        }
+    }
+    return polygon;
+}
+
+vector<Point> approximateStraightSegments(const ChainCode& chainCode, double tolerance) {
+    vector<Point> polygon;
+    polygon.push_back(chainCode.start);
+
+    // Cone [low, high] of directions from the anchor, relative to a reference angle, that pass
+    // within tolerance of every point of the current segment. A point can end the segment only
+    // if its own direction is inside the cone; otherwise the previous point closes it.
+    Point anchor = chainCode.start, previous = chainCode.start, p = chainCode.start;
+    bool constrained = false;
+    double reference = 0, low = 0, high = 0;
+    for (unsigned int i = 0; i < chainCode.length; i++) {
+        p.x += dx[chainCode.directions[i]];
+        p.y += dy[chainCode.directions[i]];
+
+        while (true) {
+            double vx = p.x - anchor.x, vy = p.y - anchor.y;
+            double distance = sqrt(vx * vx + vy * vy);
+            if (!constrained) {
+                if (distance > tolerance) {
+                    constrained = true;
+                    reference = atan2(vy, vx);
+                    low = -asin(tolerance / distance);
+                    high = -low;
+                }
+                break;
+            }
+            if (distance > 0) {
+                double relative = atan2(vy, vx) - reference;
+                if (relative > CV_PI) relative -= 2 * CV_PI;
+                if (relative < -CV_PI) relative += 2 * CV_PI;
+                double newLow = low, newHigh = high;
+                if (distance > tolerance) {
+                    double spread = asin(tolerance / distance);
+                    newLow = max(low, relative - spread);
+                    newHigh = min(high, relative + spread);
+                }
+                if (newLow <= relative && relative <= newHigh) {
+                    low = newLow;
+                    high = newHigh;
+                    break;
+                }
+            }
+            // The previous point ends the segment and anchors the next one; p is one step away
+            polygon.push_back(previous);
+            anchor = previous;
+            constrained = false;
+        }
+        previous = p;
+    }
+    return polygon;
+}
+
+void testPolygonApproximation() {
+    char fname[MAX_PATH];
+    while (openFileDlg(fname)) {
+        Mat_<uchar> src = imread(fname, IMREAD_GRAYSCALE);
+        if (src.empty()) {
+            printf("Could not open or find the image\n");
+            continue;
+        }
+
+        double tolerance;
+        printf("Enter tolerance (pixels): ");
+        scanf("%lf", &tolerance);
+
+        vector<TracedBorder> borders = traceAllBorders(src);
+        Mat douglasPeucker, straightSegments;
+        cvtColor(src, douglasPeucker, COLOR_GRAY2BGR);
+        cvtColor(src, straightSegments, COLOR_GRAY2BGR);
+
+        size_t steps = 0, dpVertices = 0, segmentVertices = 0;
+        double dpTime = 0, segmentTime = 0;
+        for (const TracedBorder& border : borders) {
+            double t = (double)getTickCount();
+            vector<Point> dp = approximateDouglasPeucker(border.chainCode, tolerance);
+            dpTime += (double)getTickCount() - t;
+            t = (double)getTickCount();
+            vector<Point> segments = approximateStraightSegments(border.chainCode, tolerance);
+            segmentTime += (double)getTickCount() - t;
+
+            steps += border.chainCode.length;
+            dpVertices += dp.size();
+            segmentVertices += segments.size();
+            polylines(douglasPeucker, dp, true, Scalar(0, 0, 255), 1);
+            polylines(straightSegments, segments, true, Scalar(0, 160, 0), 1);
+        }
+        printf("%d borders, %zu chain steps\n", (int)borders.size(), steps);
+        printf("Douglas-Peucker: %zu vertices in %.2f ms\n", dpVertices, dpTime / getTickFrequency() * 1000);
+        printf("Straight segments: %zu vertices in %.2f ms\n", segmentVertices, segmentTime / getTickFrequency() * 1000);
+
+        imshow("Original Image", src);
+        imshow("Douglas-Peucker", douglasPeucker);
+        imshow("Straight segments", straightSegments);
+        waitKey(0);
+        destroyAllWindows();
+    }
+}
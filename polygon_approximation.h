@@ -0,0 +1,20 @@
+#pragma once
+#include <opencv2/core/core.hpp>
+#include <vector>
+#include "border_detection.h"
+
+using namespace cv;
+using namespace std;
+
+// Closed polygons approximating the border of a chain code. Vertices are border points, the
+// first one is the chain start, and every border point lies within tolerance pixels of the
+// line of the polygon edge that spans it. Both read the direction stream directly.
+
+// Douglas-Peucker: each split walks the steps of its span once, carrying the position along
+vector<Point> approximateDouglasPeucker(const ChainCode& chainCode, double tolerance);
+
+// Greedy straight segments in one pass: a segment grows while the cone of directions from its
+// first vertex that pass within tolerance of every point so far stays non-empty
+vector<Point> approximateStraightSegments(const ChainCode& chainCode, double tolerance);
+
+void testPolygonApproximation();
@@ -0,0 +1,229 @@
+#include "stdafx.h"
+#include "subpixel_contours.h"
+#include "common.h"
+#include <algorithm>
+#include <cstring>
+
+// Cell sides, clockwise from the top; corners TL, TR, BR, BL
+enum { SIDE_TOP = 0, SIDE_RIGHT = 1, SIDE_BOTTOM = 2, SIDE_LEFT = 3 };
+
+class IsoLineTracer {
+    const Mat_<uchar>& gray;
+    float level;
+    int rows, cols;
+    // Per grid point: DARK, plus whether the crossing on the horizontal edge (x, y)-(x + 1, y) and
+    // on the vertical edge (x, y)-(x, y + 1) has already been used
+    enum { DARK = 1, USED_HORIZONTAL = 2, USED_VERTICAL = 4 };
+    vector<uchar> state;
+
+    bool dark(int y, int x) const {
+        return (state[(size_t)y * cols + x] & DARK) != 0;
+    }
+
+    Point2f crossing(Point a, Point b) const {
+        float ga = gray(a.y, a.x), gb = gray(b.y, b.x);
+        float t = (level - ga) / (gb - ga);
+        return Point2f(a.x + t * (b.x - a.x), a.y + t * (b.y - a.y));
+    }
+
+    // Grid points of side s of cell (row ci, column cj)
+    void sideEnds(int ci, int cj, int s, Point& a, Point& b) const {
+        switch (s) {
+        case SIDE_TOP: a = Point(cj, ci); b = Point(cj + 1, ci); break;
+        case SIDE_RIGHT: a = Point(cj + 1, ci); b = Point(cj + 1, ci + 1); break;
+        case SIDE_BOTTOM: a = Point(cj + 1, ci + 1); b = Point(cj, ci + 1); break;
+        default: a = Point(cj, ci + 1); b = Point(cj, ci); break;
+        }
+    }
+
+    // Marks the crossing on side s of cell (ci, cj); false when it was already used
+    bool use(int ci, int cj, int s) {
+        size_t index;
+        uchar flag;
+        switch (s) {
+        case SIDE_TOP: index = (size_t)ci * cols + cj; flag = USED_HORIZONTAL; break;
+        case SIDE_RIGHT: index = (size_t)ci * cols + cj + 1; flag = USED_VERTICAL; break;
+        case SIDE_BOTTOM: index = (size_t)(ci + 1) * cols + cj; flag = USED_HORIZONTAL; break;
+        default: index = (size_t)ci * cols + cj; flag = USED_VERTICAL; break;
+        }
+        if (state[index] & flag) {
+            return false;
+        }
+        state[index] |= flag;
+        return true;
+    }
+
+    int exitSide(int ci, int cj, int entry) const {
+        bool tl = dark(ci, cj), tr = dark(ci, cj + 1);
+        bool br = dark(ci + 1, cj + 1), bl = dark(ci + 1, cj);
+        bool crosses[4] = { tl != tr, tr != br, br != bl, bl != tl };
+        if (crosses[0] && crosses[1] && crosses[2] && crosses[3]) {
+            float mean = 0.25f * ((float)gray(ci, cj) + gray(ci, cj + 1) + gray(ci + 1, cj + 1) + gray(ci + 1, cj));
+            bool center = mean < level;
+            // With the center like TL, TR and BL are cut off: top-right and bottom-left pairs
+            static const int cutCorners13[4] = { SIDE_RIGHT, SIDE_TOP, SIDE_LEFT, SIDE_BOTTOM };
+            static const int cutCorners02[4] = { SIDE_LEFT, SIDE_BOTTOM, SIDE_RIGHT, SIDE_TOP };
+            return center == tl ? cutCorners13[entry] : cutCorners02[entry];
+        }
+        for (int s = 0; s < 4; s++) {
+            if (s != entry && crosses[s]) {
+                return s;
+            }
+        }
+        return -1;
+    }
+
+    // Follows the iso-line from side entry of cell (ci, cj); true when it closes on a used crossing
+    bool follow(int ci, int cj, int entry, vector<Point2f>& points) {
+        while (ci >= 0 && ci < rows - 1 && cj >= 0 && cj < cols - 1) {
+            int exit = exitSide(ci, cj, entry);
+            if (exit < 0) {
+                return false;
+            }
+            if (!use(ci, cj, exit)) {
+                return true;
+            }
+            Point a, b;
+            sideEnds(ci, cj, exit, a, b);
+            points.push_back(crossing(a, b));
+
+            static const int di[4] = { -1, 0, 1, 0 };
+            static const int dj[4] = { 0, 1, 0, -1 };
+            ci += di[exit];
+            cj += dj[exit];
+            entry = (exit + 2) % 4;
+        }
+        return false;
+    }
+
+    // Starts a contour on a crossing edge given as the side of the cell on the object's right,
+    // with the cell on the other side as the alternative for open contours
+    void traceFrom(int ci, int cj, int side, int otherCi, int otherCj, vector<SubpixelContour>& contours, int minPoints) {
+        SubpixelContour contour;
+        Point a, b;
+        sideEnds(ci, cj, side, a, b);
+        use(ci, cj, side);
+        contour.points.push_back(crossing(a, b));
+        contour.closed = follow(ci, cj, side, contour.points);
+        if (!contour.closed) {
+            vector<Point2f> before;
+            follow(otherCi, otherCj, (side + 2) % 4, before);
+            reverse(before.begin(), before.end());
+            contour.points.insert(contour.points.begin(), before.begin(), before.end());
+        }
+        if ((int)contour.points.size() >= minPoints) {
+            contours.push_back(contour);
+        }
+    }
+
+public:
+    IsoLineTracer(const Mat_<uchar>& image, float isoLevel) : gray(image), level(isoLevel), rows(image.rows), cols(image.cols) {
+        // gray < level is gray < ceil(level) for integer pixels, which keeps the loop vectorizable
+        int threshold = (int)ceil(level);
+        state.resize((size_t)rows * cols);
+        for (int y = 0; y < rows; y++) {
+            const uchar* in = gray[y];
+            uchar* out = &state[(size_t)y * cols];
+            for (int x = 0; x < cols; x++) {
+                out[x] = in[x] < threshold ? DARK : 0;
+            }
+        }
+    }
+
+    void run(vector<SubpixelContour>& contours, int minPoints) {
+        for (int y = 0; y < rows; y++) {
+            const uchar* d = &state[(size_t)y * cols];
+            const uchar* below = y + 1 < rows ? d + cols : NULL;
+            int x = 0;
+            while (x < cols) {
+                // Skip runs with no crossing 8 pixels at a time
+                if (x + 9 <= cols) {
+                    unsigned long long here, right, down;
+                    memcpy(&here, d + x, 8);
+                    memcpy(&right, d + x + 1, 8);
+                    memcpy(&down, below ? below + x : d + x, 8);
+                    const unsigned long long darkBits = 0x0101010101010101ULL;
+                    if (((here ^ right) & darkBits) == 0 && ((here ^ down) & darkBits) == 0) {
+                        x += 8;
+                        continue;
+                    }
+                }
+
+                // Horizontal edge (x, y)-(x + 1, y): cells above (y - 1) and below (y)
+                if (x + 1 < cols && ((d[x] ^ d[x + 1]) & DARK) && !(d[x] & USED_HORIZONTAL)) {
+                    if (d[x] & DARK) {
+                        traceFrom(y, x, SIDE_TOP, y - 1, x, contours, minPoints);
+                    }
+                    else {
+                        traceFrom(y - 1, x, SIDE_BOTTOM, y, x, contours, minPoints);
+                    }
+                }
+                // Vertical edge (x, y)-(x, y + 1): cells left (x - 1) and right (x)
+                if (below && ((d[x] ^ below[x]) & DARK) && !(d[x] & USED_VERTICAL)) {
+                    if (d[x] & DARK) {
+                        traceFrom(y, x - 1, SIDE_RIGHT, y, x, contours, minPoints);
+                    }
+                    else {
+                        traceFrom(y, x, SIDE_LEFT, y, x - 1, contours, minPoints);
+                    }
+                }
+                x++;
+            }
+        }
+    }
+};
+
+vector<SubpixelContour> findSubpixelContours(const Mat_<uchar>& gray, float level, int minPoints) {
+    vector<SubpixelContour> contours;
+    if (gray.rows < 2 || gray.cols < 2) {
+        return contours;
+    }
+    IsoLineTracer tracer(gray, level);
+    tracer.run(contours, minPoints);
+    return contours;
+}
+
+void testSubpixelContours() {
+    char fname[MAX_PATH];
+    while (openFileDlg(fname)) {
+        Mat_<uchar> src = imread(fname, IMREAD_GRAYSCALE);
+        if (src.empty()) {
+            printf("Could not open or find the image\n");
+            continue;
+        }
+
+        float level;
+        printf("Enter iso level (e.g. 127.5): ");
+        scanf("%f", &level);
+
+        double t = (double)getTickCount();
+        vector<SubpixelContour> contours = findSubpixelContours(src, level, 8);
+        t = ((double)getTickCount() - t) / getTickFrequency() * 1000;
+
+        size_t points = 0;
+        int closed = 0;
+        for (const SubpixelContour& c : contours) {
+            points += c.points.size();
+            closed += c.closed ? 1 : 0;
+        }
+        printf("%d contours (%d closed), %zu points in %.2f ms\n", (int)contours.size(), closed, points, t);
+
+        // Drawn at 4x with fixed point coordinates so the sub-pixel positions stay visible
+        const int zoom = 4, shift = 4;
+        Mat result;
+        resize(src, result, Size(), zoom, zoom, INTER_NEAREST);
+        cvtColor(result, result, COLOR_GRAY2BGR);
+        for (const SubpixelContour& c : contours) {
+            vector<Point> scaled(c.points.size());
+            for (size_t i = 0; i < c.points.size(); i++) {
+                scaled[i] = Point(cvRound((c.points[i].x + 0.5f) * zoom * (1 << shift)), cvRound((c.points[i].y + 0.5f) * zoom * (1 << shift)));
+            }
+            polylines(result, scaled, c.closed, Scalar(0, 0, 255), 1, LINE_AA, shift);
+        }
+
+        imshow("Original Image", src);
+        imshow("Sub-pixel contours (4x)", result);
+        waitKey(0);
+        destroyAllWindows();
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+// Iso-line of a grayscale image at a given level, through the pixel centers, with the crossing on
+// each cell edge placed by linear interpolation. Closed contours do not repeat their first point.
+struct SubpixelContour {
+    vector<Point2f> points;
+    bool closed;
+};
+
+// Marching squares over the whole image. Objects are the pixels darker than level (as in the
+// binary images, where objects are 0); each contour keeps the object on its right in image
+// coordinates. Saddle cells are split according to the mean of their four corners. Use a
+// fractional level (e.g. 127.5) so no pixel lies exactly on it.
+vector<SubpixelContour> findSubpixelContours(const Mat_<uchar>& gray, float level, int minPoints = 0);
+
+void testSubpixelContours();